@@ -126,6 +126,32 @@
 #define APP_THREAD_STACK_SIZE 0
 #endif
 
+///Define the size of CPU cache line, used to avoid false sharing.
+#ifndef APP_CACHE_LINE_SIZE
+#define APP_CACHE_LINE_SIZE 64
+#endif
+
+///Define the default capacity of each worker's local deque in work-stealing thread pool.
+#ifndef APP_THREADPOOL_DEQUE_SIZE
+#define APP_THREADPOOL_DEQUE_SIZE 1024
+#endif
+
+///Define the default capacity of the lock-free global queue in thread pool.
+#ifndef APP_THREADPOOL_QUEUE_SIZE
+#define APP_THREADPOOL_QUEUE_SIZE 4096
+#endif
+
+///Define the max size of functors stored inline in thread tasks, bigger ones are allocated from CMemoryPool.
+///A task is 64 bytes with the default size on 64-bit platforms.
+#ifndef APP_TASK_INLINE_SIZE
+#define APP_TASK_INLINE_SIZE 48
+#endif
+
+///Define to enable C++20 coroutines on thread pool, auto enabled if compiler supports.
+#if !defined(APP_USE_COROUTINE) && defined(__cpp_impl_coroutine)
+#define APP_USE_COROUTINE
+#endif
+
 ///Define for thread
 #if defined(APP_PLATFORM_LINUX) || defined(APP_PLATFORM_ANDROID)
 #define APP_HAVE_MUTEX_TIMEOUT
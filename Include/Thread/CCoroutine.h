@@ -0,0 +1,529 @@
+/**
+*@file CCoroutine.h
+*@brief This file defined C++20 coroutine tasks and awaitables on thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CCOROUTINE_H
+#define APP_CCOROUTINE_H
+
+#include "HConfig.h"
+
+#if defined(APP_USE_COROUTINE)
+
+#include "CFuture.h"
+#include "CSpinlock.h"
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace irr {
+
+/**
+*@brief Base of coroutine promises, frames are allocated from CMemoryPool,
+* a suspended coroutine only holds its frame, no thread.
+*/
+class CCoPromiseBase {
+public:
+    struct SFinalAwaiter {
+        bool await_ready()const noexcept {
+            return false;
+        }
+
+        template<class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> it)noexcept {
+            std::coroutine_handle<> next = it.promise().mContinuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume()noexcept {
+        }
+    };
+
+    std::suspend_always initial_suspend()noexcept {
+        return {};
+    }
+
+    SFinalAwaiter final_suspend()noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        std::terminate();
+    }
+
+    static void* operator new(size_t size) {
+        return CMemoryPool::allocate((u32) size);
+    }
+
+    static void operator delete(void* it, size_t size) {
+        CMemoryPool::release(it, (u32) size);
+    }
+
+    ///the coroutine awaiting this one
+    std::coroutine_handle<> mContinuation;
+
+    ///the coroutine started by AppCoSpawn(), which owns this one, null if unknown
+    std::coroutine_handle<> mRoot;
+};
+
+
+///@return The root coroutine of it, null if it's not started by AppCoSpawn().
+template<class P>
+std::coroutine_handle<> AppCoRoot(std::coroutine_handle<P> it) {
+    if constexpr(std::is_base_of<CCoPromiseBase, P>::value) {
+        return it.promise().mRoot;
+    } else {
+        return nullptr;
+    }
+}
+
+
+/**
+*@class CCoResume
+*@brief Resume of a suspended coroutine posted to pool, it's a part of the coroutine
+* frame, so posting allocates nothing.
+*@note If the pool drops it, eg: stopped, the root coroutine is destroyed with the
+* frames it awaits, and the future of AppCoSpawn() is cancelled. A coroutine with
+* an unknown root is resumed in current thread.
+*/
+class CCoResume : public IRunnable {
+public:
+    CCoResume() {
+    }
+
+    template<class P>
+    void setHandle(std::coroutine_handle<P> it) {
+        mHandle = it;
+        mRoot = AppCoRoot(it);
+    }
+
+    virtual void run()override {
+        mHandle.resume();
+    }
+
+    virtual void cancel()override;
+
+private:
+    std::coroutine_handle<> mHandle;
+    std::coroutine_handle<> mRoot;
+};
+
+
+template<class T>
+class CCoPromise : public CCoPromiseBase {
+public:
+    static_assert(alignof(T) <= CMemoryPool::EALIGN_SIZE,
+        "coroutine frame is allocated from CMemoryPool, over-aligned value is not supported");
+
+    CCoPromise() : mReady(false) {
+    }
+
+    ~CCoPromise() {
+        if(mReady) {
+            ((T*) mValue)->~T();
+        }
+    }
+
+    template<class V>
+    void return_value(V&& it) {
+        new (mValue) T(std::forward<V>(it));
+        mReady = true;
+    }
+
+    T& getValue() {
+        return *(T*) mValue;
+    }
+
+private:
+    alignas(T) s8 mValue[sizeof(T)];
+    bool mReady;
+};
+
+
+template<>
+class CCoPromise<void> : public CCoPromiseBase {
+public:
+    void return_void() {
+    }
+
+    void getValue() {
+    }
+};
+
+
+/**
+*@class CCoTask
+*@brief A lazy coroutine task, it starts when awaited, and resumes
+* the awaiting coroutine by symmetric transfer when finished.
+*@note Use AppCoSpawn() to start a task from normal code.
+*/
+template<class T = void>
+class CCoTask {
+public:
+    class promise_type : public CCoPromise<T> {
+    public:
+        CCoTask get_return_object() {
+            return CCoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    CCoTask() : mHandle(nullptr) {
+    }
+
+    CCoTask(CCoTask&& it) : mHandle(it.mHandle) {
+        it.mHandle = nullptr;
+    }
+
+    ~CCoTask() {
+        if(mHandle) {
+            mHandle.destroy();
+        }
+    }
+
+    CCoTask& operator=(CCoTask&& it) {
+        if(this != &it) {
+            if(mHandle) {
+                mHandle.destroy();
+            }
+            mHandle = it.mHandle;
+            it.mHandle = nullptr;
+        }
+        return *this;
+    }
+
+    bool isValid()const {
+        return (bool) mHandle;
+    }
+
+    bool await_ready()const noexcept {
+        return !mHandle || mHandle.done();
+    }
+
+    template<class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> it)noexcept {
+        mHandle.promise().mContinuation = it;
+        mHandle.promise().mRoot = AppCoRoot(it);
+        return mHandle;
+    }
+
+    T await_resume() {
+        if constexpr(std::is_void<T>::value) {
+            return;
+        } else {
+            return std::move(mHandle.promise().getValue());
+        }
+    }
+
+private:
+    CCoTask(const CCoTask& it) = delete;
+    CCoTask& operator=(const CCoTask& it) = delete;
+
+    explicit CCoTask(std::coroutine_handle<promise_type> it) : mHandle(it) {
+    }
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+
+/**
+*@brief Awaitable which resumes the coroutine on a worker of pool.
+*@note If the pool rejects it, the coroutine continues in current thread.
+*/
+class CCoSchedule {
+public:
+    explicit CCoSchedule(CThreadPool& pool) : mPool(pool) {
+    }
+
+    bool await_ready()const noexcept {
+        return false;
+    }
+
+    template<class P>
+    bool await_suspend(std::coroutine_handle<P> it) {
+        mResume.setHandle(it);
+        return mPool.addTask(&mResume);
+    }
+
+    void await_resume()noexcept {
+    }
+
+private:
+    CThreadPool& mPool;
+    CCoResume mResume;
+};
+
+
+inline CCoSchedule AppCoSchedule(CThreadPool& pool) {
+    return CCoSchedule(pool);
+}
+
+
+///a suspended coroutine in the wait list of CCoEvent, CCoSemaphore or CCoMutex
+struct SCoWaiter {
+    CThreadPool* mPool;
+    CCoResume mResume;
+    SCoWaiter* mNext;
+};
+
+
+/**
+*@class CCoWaitList
+*@brief Base of coroutine sync objects. A coroutine which can't acquire the object
+* is linked in the list, and holds no thread. The releasing thread unlinks it and
+* posts it to its pool, or resumes it inline if the pool rejects it.
+*/
+class CCoWaitList {
+public:
+    CCoWaitList() : mHead(0), mTail(0) {
+    }
+
+    ~CCoWaitList() {
+        APP_ASSERT(0 == mHead);
+    }
+
+protected:
+    ///append it to the list, guarded by mLock
+    void push(SCoWaiter& it) {
+        it.mNext = 0;
+        if(mTail) {
+            mTail->mNext = &it;
+        } else {
+            mHead = &it;
+        }
+        mTail = &it;
+    }
+
+    ///unlink the oldest waiter, guarded by mLock
+    SCoWaiter* pop() {
+        SCoWaiter* ret = mHead;
+        if(ret) {
+            mHead = ret->mNext;
+            if(0 == mHead) {
+                mTail = 0;
+            }
+        }
+        return ret;
+    }
+
+    ///resume a list of unlinked waiters, called without mLock
+    static void resume(SCoWaiter* it);
+
+    CSpinlock mLock;
+    SCoWaiter* mHead;
+    SCoWaiter* mTail;
+
+private:
+    CCoWaitList(const CCoWaitList& it) = delete;
+    CCoWaitList& operator=(const CCoWaitList& it) = delete;
+};
+
+
+/**
+*@brief Awaitable of coroutine sync objects, T provides tryAcquire() and suspend().
+* The waiter is a part of coroutine frame, so waiting allocates nothing.
+*/
+template<class T>
+class CCoAwaiter {
+public:
+    CCoAwaiter(CThreadPool& pool, T& it) : mObject(it) {
+        mWaiter.mPool = &pool;
+        mWaiter.mNext = 0;
+    }
+
+    bool await_ready() {
+        return mObject.tryAcquire();
+    }
+
+    template<class P>
+    bool await_suspend(std::coroutine_handle<P> it) {
+        mWaiter.mResume.setHandle(it);
+        //@note: may be resumed by a releasing thread already, don't touch this.
+        return mObject.suspend(mWaiter);
+    }
+
+    void await_resume()noexcept {
+    }
+
+private:
+    T& mObject;
+    SCoWaiter mWaiter;
+};
+
+
+/**
+*@class CCoEvent
+*@brief An event for coroutines, set() resumes waiting coroutines on their pools.
+*@note This is not a CThreadEvent, threads can't block on it.
+*/
+class CCoEvent : public CCoWaitList {
+public:
+    /**
+    *@param autoReset Only one waiter is resumed by a set() if true, else all waiters
+    * are resumed and the event stays signalled until reset().
+    */
+    explicit CCoEvent(bool autoReset = false) : mSignaled(false), mAutoReset(autoReset) {
+    }
+
+    void set();
+
+    void reset();
+
+private:
+    template<class T>
+    friend class CCoAwaiter;
+
+    bool tryAcquire();
+
+    ///@return false if acquired without suspending.
+    bool suspend(SCoWaiter& it);
+
+    bool mSignaled;
+    bool mAutoReset;
+};
+
+
+/**
+*@class CCoSemaphore
+*@brief A counting semaphore for coroutines, post() resumes waiting coroutines in FIFO order.
+*/
+class CCoSemaphore : public CCoWaitList {
+public:
+    explicit CCoSemaphore(u32 count = 0) : mCount(count) {
+    }
+
+    void post(u32 count = 1);
+
+private:
+    template<class T>
+    friend class CCoAwaiter;
+
+    bool tryAcquire();
+
+    bool suspend(SCoWaiter& it);
+
+    u32 mCount;
+};
+
+
+/**
+*@class CCoMutex
+*@brief A mutex for coroutines, unlock() hands the lock to the oldest waiter.
+* It's not owned by a thread, a coroutine may lock it on a worker and unlock it on another.
+*/
+class CCoMutex : public CCoWaitList {
+public:
+    CCoMutex() : mLocked(false) {
+    }
+
+    bool tryLock() {
+        return tryAcquire();
+    }
+
+    void unlock();
+
+private:
+    template<class T>
+    friend class CCoAwaiter;
+
+    bool tryAcquire();
+
+    bool suspend(SCoWaiter& it);
+
+    bool mLocked;
+};
+
+
+///co_await AppCoWait(pool, event);
+inline CCoAwaiter<CCoEvent> AppCoWait(CThreadPool& pool, CCoEvent& it) {
+    return CCoAwaiter<CCoEvent>(pool, it);
+}
+
+///co_await AppCoWait(pool, semaphore);
+inline CCoAwaiter<CCoSemaphore> AppCoWait(CThreadPool& pool, CCoSemaphore& it) {
+    return CCoAwaiter<CCoSemaphore>(pool, it);
+}
+
+///co_await AppCoLock(pool, mutex);
+inline CCoAwaiter<CCoMutex> AppCoLock(CThreadPool& pool, CCoMutex& it) {
+    return CCoAwaiter<CCoMutex>(pool, it);
+}
+
+
+///a started coroutine which destroys itself when finished
+struct SCoDetached {
+    struct promise_type : public CCoPromiseBase {
+        SCoDetached get_return_object()noexcept {
+            mRoot = std::coroutine_handle<promise_type>::from_promise(*this);
+            return {};
+        }
+
+        std::suspend_never initial_suspend()noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend()noexcept {
+            return {};
+        }
+
+        void return_void()noexcept {
+        }
+    };
+};
+
+
+///cancels the state if the frame is destroyed before the value is set.
+class CCoStateHolder {
+public:
+    explicit CCoStateHolder(CFutureStateBase* it) : mState(it) {
+    }
+
+    ~CCoStateHolder() {
+        mState->cancel();
+        mState->drop();
+    }
+
+private:
+    CCoStateHolder(const CCoStateHolder& it) = delete;
+    CCoStateHolder& operator=(const CCoStateHolder& it) = delete;
+
+    CFutureStateBase* mState;
+};
+
+
+template<class T>
+SCoDetached AppCoDrive(CThreadPool& pool, CCoTask<T> task, CFutureState<T>* state) {
+    CCoStateHolder holder(state);
+    co_await AppCoSchedule(pool);
+    if constexpr(std::is_void<T>::value) {
+        co_await task;
+        state->setValue();
+    } else {
+        state->setValue(co_await task);
+    }
+}
+
+
+/**
+*@brief Start a task on a worker of pool.
+*@return The future of task's result, invalid if task is invalid.
+*/
+template<class T>
+CFuture<T> AppCoSpawn(CThreadPool& pool, CCoTask<T> task) {
+    if(!task.isValid()) {
+        return CFuture<T>();
+    }
+    CFutureState<T>* state = new CFutureState<T>(&pool);
+    CFuture<T> ret(state);
+    state->grab();
+    AppCoDrive(pool, std::move(task), state);
+    return ret;
+}
+
+}//irr
+
+#endif //APP_USE_COROUTINE
+
+#endif	/* APP_CCOROUTINE_H */
@@ -0,0 +1,159 @@
+/**
+*@file CEpoch.h
+*@brief This file defined epoch based memory reclamation, for RCU-style publishing.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CEPOCH_H
+#define APP_CEPOCH_H
+
+#include "CThread.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+class CThreadPool;
+
+/**
+*@class CEpoch
+*@brief Epoch based reclamation, readers never block and writers never wait readers.
+* A reader enters a critical section, loads shared pointers and uses the objects,
+* then leaves. A writer swaps in a new version and retires the old one, which is freed
+* after a grace period, when every thread has left the critical sections it was in.
+* Each thread gets a record at its first call, and releases it at thread exit,
+* so any thread can use it, CThread workers, pool workers, or the main thread.
+*
+* enter() and leave() are a store to the thread's own record each. The ordering against
+* the reclaimer is made by a process wide barrier in reclaim() (membarrier on Linux,
+* FlushProcessWriteBuffers on Windows), enter() uses a full barrier if it's not supported.
+*@note Retired objects are freed in batches, by reclaim() when a thread has enough
+* retired objects, or by the pool set by setPool(). Objects left by exited threads
+* are freed by reclaim() of other threads. Don't call synchronize() inside a critical section.
+*/
+class CEpoch {
+public:
+    /**
+    *@brief Enter a critical section, can be nested.
+    */
+    static void enter();
+
+    static void leave();
+
+    /**
+    *@return true if current thread is in a critical section.
+    */
+    static bool isInside();
+
+    /**
+    *@brief Free an object by deleter(it) after a grace period.
+    *@param it The object, no longer reachable by new readers.
+    */
+    static void retire(void* it, AppCallable deleter);
+
+    ///delete it after a grace period
+    template<class T>
+    static void retire(T* it) {
+        retire((void*) it, &CEpoch::destroy<T>);
+    }
+
+    /**
+    *@brief Try to advance the epoch and free objects retired by current thread
+    * and exited threads which have passed the grace period.
+    *@return Count of objects freed, or posted to pool.
+    */
+    static u32 reclaim();
+
+    /**
+    *@brief Wait for a grace period, then free objects retired by current thread
+    * and exited threads before calling.
+    */
+    static void synchronize();
+
+    /**
+    *@brief Run deleters of batches in pool, so writers don't pay for freeing.
+    *@param pool The pool, null to free in the thread calling reclaim().
+    *@note Set null before the pool is destroyed, batches rejected or dropped by pool are freed inline.
+    */
+    static void setPool(CThreadPool* pool);
+
+    /**
+    *@return Count of epochs advanced.
+    */
+    static u32 getEpoch();
+
+    /**
+    *@return Count of retired objects not freed yet.
+    */
+    static u32 getPending();
+
+private:
+    template<class T>
+    static void destroy(void* it) {
+        delete (T*) it;
+    }
+};
+
+
+class CAutoEpoch {
+public:
+    CAutoEpoch() {
+        CEpoch::enter();
+    }
+
+    ~CAutoEpoch() {
+        CEpoch::leave();
+    }
+
+private:
+    CAutoEpoch(const CAutoEpoch& it) = delete;
+    CAutoEpoch& operator=(const CAutoEpoch& it) = delete;
+};
+
+
+/**
+*@class CEpochPointer
+*@brief A shared pointer to immutable versions of T, eg: routing tables.
+* Readers load() inside CAutoEpoch, writers publish new versions by store(),
+* the old version is retired and deleted after a grace period.
+*/
+template<class T>
+class CEpochPointer {
+public:
+    CEpochPointer(T* it = 0) : mPointer(it) {
+    }
+
+    /**
+    *@brief Delete current version at once, no reader should be using it.
+    */
+    ~CEpochPointer() {
+        delete (T*) mPointer;
+    }
+
+    /**
+    *@return Current version, valid until current thread leaves the critical section.
+    */
+    T* load()const {
+        return (T*) AppAtomicFetch((void**) &mPointer);
+    }
+
+    /**
+    *@brief Publish a new version, and retire the old one.
+    */
+    void store(T* it) {
+        T* old = (T*) AppAtomicFetchSet((void*) it, &mPointer);
+        if(old) {
+            CEpoch::retire(old);
+        }
+    }
+
+private:
+    CEpochPointer(const CEpochPointer& it) = delete;
+    CEpochPointer& operator=(const CEpochPointer& it) = delete;
+
+    void* mPointer;
+};
+
+}//irr
+
+#endif	/* APP_CEPOCH_H */
@@ -0,0 +1,101 @@
+/**
+*@file CFastMutex.h
+*@brief This file defined a compact adaptive mutex base on futex.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CFASTMUTEX_H
+#define APP_CFASTMUTEX_H
+
+#include "HConfig.h"
+#include "irrTypes.h"
+
+namespace irr {
+
+/**
+*@class CFastMutex
+*@brief A 4 bytes non-recursive mutex for short critical sections.
+* A contended lock() spins first, the spin budget is learned from how long
+* recent waiters spun before getting the lock, then sleeps in kernel
+* (futex on Linux, WaitOnAddress on Windows).
+* unlock() makes no syscall if nobody is sleeping.
+*@note It can't be used with CCondition, use CMutex for that.
+*/
+class CFastMutex {
+public:
+    CFastMutex();
+
+    ~CFastMutex();
+
+    void lock();
+
+    /**
+    *@return true if locked, else false immediately.
+    */
+    bool tryLock();
+
+    /**
+    *@brief Blocks up to the given number of milliseconds if the mutex is held by another thread.
+    *@return true if locked, else false.
+    */
+    bool tryLock(long milliseconds);
+
+    void unlock();
+
+    /**
+    *@return Spins of the learned budget.
+    */
+    u32 getSpinBudget()const;
+
+private:
+    CFastMutex(const CFastMutex& it) = delete;
+    CFastMutex& operator=(const CFastMutex& it) = delete;
+
+    enum EState {
+        ES_LOCKED = 1,              ///<bit of locked
+        ES_WAITING = 2,             ///<bit of sleeping waiters
+        ES_MASK = 3,
+        ES_BUDGET_SHIFT = 16        ///<the high 16 bits is the learned spin budget
+    };
+
+    /**
+    *@brief Spin to lock within the learned budget.
+    *@param spins Spins used.
+    *@return true if locked.
+    */
+    bool spinLock(u32& spins);
+
+    /**
+    *@brief Move the budget 1/8 toward spins used by a contended lock(), called by holder only.
+    */
+    void updateBudget(u32 spins);
+
+    /**
+    *@param milliseconds Max time to block, <0 means no timeout.
+    *@return true if locked, false if timeout.
+    */
+    bool waitLock(long milliseconds);
+
+    ///state bits and spin budget, the word is also the futex.
+    s32 mValue;
+};
+
+
+class CAutoFastLock {
+public:
+    CAutoFastLock(CFastMutex& it) : mMutex(it) {
+        mMutex.lock();
+    }
+
+    ~CAutoFastLock() {
+        mMutex.unlock();
+    }
+
+private:
+    CFastMutex& mMutex;
+};
+
+}//irr
+
+#endif	/* APP_CFASTMUTEX_H */
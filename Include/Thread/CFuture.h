@@ -0,0 +1,542 @@
+/**
+*@file CFuture.h
+*@brief This file defined future, promise and continuations on thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CFUTURE_H
+#define APP_CFUTURE_H
+
+#include "CThreadPool.h"
+#include "CSpinlock.h"
+#include "CMemoryPool.h"
+#include "irrArray.h"
+#include <new>
+
+namespace irr {
+
+/**
+*@class CFutureStateBase
+*@brief Shared state of a future, reference counted, allocated from CMemoryPool.
+* A new state has no reference, the first owner grabs it.
+* Continuations are run inline by the thread which sets the value.
+* A state is ready when the value is set, or when it's cancelled without value,
+* eg: the task was dropped by a stopped pool.
+*/
+class CFutureStateBase {
+public:
+    /**
+    *@brief A callback node linked into the state, run() is called once
+    * when the state becomes ready, and it releases itself if needed.
+    */
+    class IContinuation {
+    public:
+        IContinuation() : mNext(0) {
+        }
+
+        virtual ~IContinuation() {
+        }
+
+        virtual void run() = 0;
+
+        static void* operator new(size_t size) {
+            return CMemoryPool::allocate((u32) size);
+        }
+
+        static void operator delete(void* it, size_t size) {
+            CMemoryPool::release(it, (u32) size);
+        }
+
+        IContinuation* mNext;
+    };
+
+    CFutureStateBase(CThreadPool* pool);
+
+    virtual ~CFutureStateBase();
+
+    void grab();
+
+    /**
+    *@brief Release a reference, the state is deleted when no reference left.
+    */
+    void drop();
+
+    /**
+    *@return true if value is set or cancelled.
+    */
+    bool isReady()const;
+
+    bool isCancelled()const;
+
+    /**
+    *@brief Make it ready without value, waiters wake and continuations run.
+    *@return false if value was already set.
+    */
+    bool cancel();
+
+    /**
+    *@brief Wait until ready.
+    *@note Runs waiting tasks of the pool while waiting, then blocks until ready
+    * when the pool has no task.
+    */
+    void wait();
+
+    /**
+    *@brief Link a continuation which will be run when ready.
+    *@return false if already ready, the continuation is not linked and the caller should run it.
+    */
+    bool addContinuation(IContinuation* it);
+
+    CThreadPool* getPool()const {
+        return mPool;
+    }
+
+    static void* operator new(size_t size) {
+        return CMemoryPool::allocate((u32) size);
+    }
+
+    static void operator delete(void* it, size_t size) {
+        CMemoryPool::release(it, (u32) size);
+    }
+
+protected:
+    /**
+    *@brief Claim the right to set value.
+    *@return false if value was already set.
+    */
+    bool beginSet();
+
+    /**
+    *@brief Mark ready and run all continuations, call after beginSet() success.
+    */
+    void setReady();
+
+    bool hasValue()const;
+
+private:
+    CFutureStateBase(const CFutureStateBase& it) = delete;
+    CFutureStateBase& operator=(const CFutureStateBase& it) = delete;
+
+    enum EStatus {
+        ES_PENDING = 0,
+        ES_SETTING,
+        ES_READY,
+        ES_CANCELLED
+    };
+
+    void complete(s32 status);
+
+    s32 mRefCount;
+    s32 mStatus;
+    CThreadPool* mPool;
+    CSpinlock mLock;
+    IContinuation* mContinuations;
+};
+
+
+template<class T>
+class CFutureState : public CFutureStateBase {
+public:
+    static_assert(alignof(T) <= CMemoryPool::EALIGN_SIZE,
+        "future state is allocated from CMemoryPool, over-aligned value is not supported");
+
+    CFutureState(CThreadPool* pool) : CFutureStateBase(pool) {
+    }
+
+    virtual ~CFutureState() {
+        if(hasValue()) {
+            ((T*) mValue)->~T();
+        }
+    }
+
+    bool setValue(const T& it) {
+        if(!beginSet()) {
+            return false;
+        }
+        new (mValue) T(it);
+        setReady();
+        return true;
+    }
+
+    const T& getValue()const {
+        return *(const T*) mValue;
+    }
+
+private:
+    alignas(T) s8 mValue[sizeof(T)];
+};
+
+
+template<>
+class CFutureState<void> : public CFutureStateBase {
+public:
+    CFutureState(CThreadPool* pool) : CFutureStateBase(pool) {
+    }
+
+    bool setValue() {
+        if(!beginSet()) {
+            return false;
+        }
+        setReady();
+        return true;
+    }
+
+    void getValue()const {
+    }
+};
+
+
+///type traits of future
+template<class T>
+struct SFutureTraits {
+    typedef const T& TResult;
+
+    template<class F>
+    struct SNext {
+        typedef decltype((*(F*) 0)(*(const T*) 0)) TType;
+    };
+
+    template<class F>
+    static typename SNext<F>::TType call(CFutureState<T>* state, F& func) {
+        return func(state->getValue());
+    }
+};
+
+
+template<>
+struct SFutureTraits<void> {
+    typedef void TResult;
+
+    template<class F>
+    struct SNext {
+        typedef decltype((*(F*) 0)()) TType;
+    };
+
+    template<class F>
+    static typename SNext<F>::TType call(CFutureState<void>* state, F& func) {
+        return func();
+    }
+};
+
+
+///set the result of func() to state
+template<class R>
+struct SFutureSetter {
+    template<class F>
+    static void set(CFutureState<R>* state, F& func) {
+        state->setValue(func());
+    }
+};
+
+
+template<>
+struct SFutureSetter<void> {
+    template<class F>
+    static void set(CFutureState<void>* state, F& func) {
+        func();
+        state->setValue();
+    }
+};
+
+
+/**
+*@class CFuture
+*@brief A handle of the result of an asynchronous operation, copyable.
+*/
+template<class T>
+class CFuture {
+public:
+    CFuture() : mState(0) {
+    }
+
+    /**
+    *@brief Take a reference of state.
+    */
+    explicit CFuture(CFutureState<T>* it) : mState(it) {
+        if(mState) {
+            mState->grab();
+        }
+    }
+
+    CFuture(const CFuture& it) : mState(it.mState) {
+        if(mState) {
+            mState->grab();
+        }
+    }
+
+    ~CFuture() {
+        if(mState) {
+            mState->drop();
+        }
+    }
+
+    CFuture& operator=(const CFuture& it) {
+        if(it.mState) {
+            it.mState->grab();
+        }
+        if(mState) {
+            mState->drop();
+        }
+        mState = it.mState;
+        return *this;
+    }
+
+    /**
+    *@return false if this future has no state, eg: the task was rejected by pool.
+    */
+    bool isValid()const {
+        return 0 != mState;
+    }
+
+    bool isReady()const {
+        return mState && mState->isReady();
+    }
+
+    /**
+    *@return true if it's ready without value, eg: the task was dropped by a stopped pool.
+    */
+    bool isCancelled()const {
+        return mState && mState->isCancelled();
+    }
+
+    void wait()const {
+        if(mState) {
+            mState->wait();
+        }
+    }
+
+    /**
+    *@brief Wait and get the value.
+    *@note The future must be valid, and not cancelled.
+    */
+    typename SFutureTraits<T>::TResult get()const {
+        APP_ASSERT(mState);
+        mState->wait();
+        APP_ASSERT(!mState->isCancelled());
+        return mState->getValue();
+    }
+
+    /**
+    *@brief Chain a continuation, func(value) is called inline by the thread
+    * which sets the value of this future, or by the calling thread if already ready.
+    * If this future is cancelled, func is not called and the returned future is cancelled.
+    *@param func Callable as R func(const T&), or R func() if T is void.
+    *@return The future of the continuation's result, invalid if this future is invalid.
+    */
+    template<class F>
+    CFuture<typename SFutureTraits<T>::template SNext<F>::TType> then(F func)const;
+
+    CFutureState<T>* getState()const {
+        return mState;
+    }
+
+private:
+    CFutureState<T>* mState;
+};
+
+
+/**
+*@class CPromise
+*@brief The producer side of a future, the value can be set only once.
+*@note The future is cancelled if promise is destroyed without setting value.
+*/
+template<class T>
+class CPromise {
+public:
+    /**
+    *@param pool The pool helped by waiters of the future, can be null.
+    */
+    CPromise(CThreadPool* pool = 0) : mState(new CFutureState<T>(pool)) {
+        mState->grab();
+    }
+
+    ~CPromise() {
+        mState->cancel();
+        mState->drop();
+    }
+
+    CFuture<T> getFuture()const {
+        return CFuture<T>(mState);
+    }
+
+    /**
+    *@brief Set the value and run continuations in calling thread.
+    *@return false if value was already set.
+    */
+    template<class... TArgs>
+    bool setValue(const TArgs&... it) {
+        return mState->setValue(it...);
+    }
+
+    /**
+    *@brief Make the future ready without value.
+    *@return false if value was already set.
+    */
+    bool cancel() {
+        return mState->cancel();
+    }
+
+private:
+    CPromise(const CPromise& it) = delete;
+    CPromise& operator=(const CPromise& it) = delete;
+
+    CFutureState<T>* mState;
+};
+
+
+///continuation created by CFuture::then()
+template<class T, class R, class F>
+class CFutureThen : public CFutureStateBase::IContinuation {
+public:
+    CFutureThen(CFutureState<T>* source, CFutureState<R>* target, const F& func) :
+        mSource(source),
+        mTarget(target),
+        mFunction(func) {
+        mTarget->grab();
+    }
+
+    virtual ~CFutureThen() {
+        mTarget->drop();
+    }
+
+    virtual void run()override {
+        if(mSource->isCancelled()) {
+            mTarget->cancel();
+        } else {
+            auto call = [this]() {
+                return SFutureTraits<T>::call(mSource, mFunction);
+            };
+            SFutureSetter<R>::set(mTarget, call);
+        }
+        delete this;
+    }
+
+private:
+    CFutureState<T>* mSource;
+    CFutureState<R>* mTarget;
+    F mFunction;
+};
+
+
+template<class T>
+template<class F>
+CFuture<typename SFutureTraits<T>::template SNext<F>::TType> CFuture<T>::then(F func)const {
+    typedef typename SFutureTraits<T>::template SNext<F>::TType R;
+    if(!mState) {
+        return CFuture<R>();
+    }
+    CFuture<R> ret(new CFutureState<R>(mState->getPool()));
+    CFutureThen<T, R, F>* node = new CFutureThen<T, R, F>(mState, ret.getState(), func);
+    if(!mState->addContinuation(node)) {
+        node->run();
+    }
+    return ret;
+}
+
+
+///task posted to pool by AppAsync()
+template<class R, class F>
+class CFutureTask : public IRunnable {
+public:
+    CFutureTask(CFutureState<R>* target, const F& func) :
+        mTarget(target),
+        mFunction(func) {
+        mTarget->grab();
+    }
+
+    virtual ~CFutureTask() {
+        mTarget->drop();
+    }
+
+    virtual void run()override {
+        SFutureSetter<R>::set(mTarget, mFunction);
+        delete this;
+    }
+
+    ///dropped by a stopped pool
+    virtual void cancel()override {
+        mTarget->cancel();
+        delete this;
+    }
+
+    static void* operator new(size_t size) {
+        return CMemoryPool::allocate((u32) size);
+    }
+
+    static void operator delete(void* it, size_t size) {
+        CMemoryPool::release(it, (u32) size);
+    }
+
+private:
+    CFutureState<R>* mTarget;
+    F mFunction;
+};
+
+
+/**
+*@brief Run func() in pool.
+*@param func Callable as R func().
+*@return The future of func's result, invalid if the pool rejected the task.
+*/
+template<class F>
+CFuture<decltype((*(F*) 0)())> AppAsync(CThreadPool& pool, F func) {
+    typedef decltype((*(F*) 0)()) R;
+    CFuture<R> ret(new CFutureState<R>(&pool));
+    CFutureTask<R, F>* task = new CFutureTask<R, F>(ret.getState(), func);
+    if(!pool.addTask(task)) {
+        delete task;
+        return CFuture<R>();
+    }
+    return ret;
+}
+
+
+/**
+*@brief Run iFunc(iData) in pool.
+*@return The future, invalid if the pool rejected the task.
+*/
+inline CFuture<void> AppAsync(CThreadPool& pool, AppCallable iFunc, void* iData = 0) {
+    auto call = [iFunc, iData]() {
+        iFunc(iData);
+    };
+    return AppAsync(pool, call);
+}
+
+
+/**
+*@brief Create a future which is ready when all states are ready.
+*@param states States to wait, null items are skipped.
+*/
+CFuture<void> AppWhenAll(CFutureStateBase* const* states, u32 count);
+
+/**
+*@brief Create a future which is ready when any state is ready.
+*@param states States to wait, null items are skipped.
+*@return The future of the index of the first ready state, invalid if no valid state.
+*/
+CFuture<u32> AppWhenAny(CFutureStateBase* const* states, u32 count);
+
+
+template<class T, class TAlloc>
+CFuture<void> AppWhenAll(const core::array<CFuture<T>, TAlloc>& futures) {
+    core::array<CFutureStateBase*> states(futures.size());
+    for(u32 i = 0; i < futures.size(); ++i) {
+        states.push_back(futures[i].getState());
+    }
+    return AppWhenAll(states.const_pointer(), states.size());
+}
+
+
+template<class T, class TAlloc>
+CFuture<u32> AppWhenAny(const core::array<CFuture<T>, TAlloc>& futures) {
+    core::array<CFutureStateBase*> states(futures.size());
+    for(u32 i = 0; i < futures.size(); ++i) {
+        states.push_back(futures[i].getState());
+    }
+    return AppWhenAny(states.const_pointer(), states.size());
+}
+
+}//irr
+
+#endif	/* APP_CFUTURE_H */
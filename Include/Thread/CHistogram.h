@@ -0,0 +1,96 @@
+/**
+*@file CHistogram.h
+*@brief This file defined a log-linear histogram of latencies.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CHISTOGRAM_H
+#define APP_CHISTOGRAM_H
+
+#include "HConfig.h"
+#include "irrTypes.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+/**
+*@class CHistogram
+*@brief A HDR style histogram, each power of 2 range is split into 8 linear
+* buckets, so a recorded value is kept with 12.5% precision at most.
+* Values not less than 2^36 (about 68 seconds in nanoseconds) are put in the last bucket.
+*@note Single writer, counters are stored by relaxed atomics, so a reader on
+* other thread gets approximate counts, but no torn one.
+*/
+class alignas(8) CHistogram {
+public:
+    enum {
+        ESUB_BITS = 3,
+        ESUB_COUNT = 1 << ESUB_BITS,
+        ESUB_MASK = ESUB_COUNT - 1,
+        EMAX_BITS = 36,
+        EBUCKET_COUNT = (EMAX_BITS - ESUB_BITS + 1) << ESUB_BITS
+    };
+
+    CHistogram() {
+        clear();
+    }
+
+    void clear();
+
+    ///called by the writer only
+    void add(u64 value) {
+        AppCounterAdd(&mBuckets[getBucket(value)], (u64) 1);
+        AppCounterAdd(&mCount, (u64) 1);
+        AppCounterAdd(&mSum, value);
+        if(value > mMax) {
+            AppAtomicStoreRelaxed(value, &mMax);
+        }
+    }
+
+    /**
+    *@brief Add all records of another histogram, which may be written by other thread.
+    */
+    void merge(const CHistogram& it);
+
+    u64 getCount()const {
+        return AppAtomicLoadRelaxed(&mCount);
+    }
+
+    u64 getMax()const {
+        return AppAtomicLoadRelaxed(&mMax);
+    }
+
+    u64 getMean()const {
+        const u64 cnt = getCount();
+        return cnt > 0 ? AppAtomicLoadRelaxed(&mSum) / cnt : 0;
+    }
+
+    /**
+    *@param percent In [0, 100], eg: 99.9
+    *@return The upper bound of the bucket which has the percentile, 0 if empty.
+    */
+    u64 getPercentile(f64 percent)const;
+
+    u64 getBucketCount(u32 bucket)const {
+        return bucket < EBUCKET_COUNT ? AppAtomicLoadRelaxed(&mBuckets[bucket]) : 0;
+    }
+
+    static u32 getBucket(u64 value);
+
+    ///@return The lowest value of bucket.
+    static u64 getBucketLow(u32 bucket);
+
+    ///@return The highest value of bucket.
+    static u64 getBucketHigh(u32 bucket);
+
+private:
+    u64 mCount;
+    u64 mSum;
+    u64 mMax;
+    u64 mBuckets[EBUCKET_COUNT];
+};
+
+}//irr
+
+#endif	/* APP_CHISTOGRAM_H */
@@ -0,0 +1,65 @@
+/**
+*@file CLatch.h
+*@brief This file defined a count down latch.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CLATCH_H
+#define APP_CLATCH_H
+
+#include "CThreadEvent.h"
+
+namespace irr {
+
+/**
+*@class CLatch
+*@brief Waiters are blocked until the count reaches zero.
+* countDown() is lock free, only the last one signals the event.
+*@note reset() must not be called while other threads are waiting.
+*/
+class CLatch {
+public:
+    CLatch(u32 count = 0);
+
+    ~CLatch();
+
+    /**
+    *@brief Set a new count, a zero count opens the latch at once.
+    */
+    void reset(u32 count);
+
+    /**
+    *@brief Decrease the count, wake all waiters when it reaches zero.
+    *@note Extra calls after zero are ignored.
+    */
+    void countDown();
+
+    /**
+    *@return true if the count reached zero.
+    */
+    bool isOpen()const;
+
+    /**
+    *@brief Wait until the count reaches zero.
+    */
+    void wait();
+
+    /**
+    *@brief Wait until the count reaches zero.
+    *@param milliseconds Max time to wait.
+    *@return true if the count reached zero, false if timeout.
+    */
+    bool wait(long milliseconds);
+
+private:
+    CLatch(const CLatch& it) = delete;
+    CLatch& operator=(const CLatch& it) = delete;
+
+    s32 mCount;
+    CThreadEvent mEvent;
+};
+
+}//irr
+
+#endif	/* APP_CLATCH_H */
@@ -0,0 +1,79 @@
+/**
+*@file CMemoryPool.h
+*@brief This file defined a thread safe pool of fixed size memory blocks.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CMEMORYPOOL_H
+#define APP_CMEMORYPOOL_H
+
+#include "HConfig.h"
+#include "irrTypes.h"
+#include "CSpinlock.h"
+
+namespace irr {
+
+/**
+*@class CMemoryPool
+*@brief A thread safe pool of fixed size memory blocks.
+* Blocks are carved from chunks and recycled through a free list,
+* chunks are only released when the pool is destroyed.
+*/
+class CMemoryPool {
+public:
+    enum {
+        ///alignment of blocks from allocate(size), as malloc() does
+        EALIGN_SIZE = 2 * sizeof(void*)
+    };
+
+    /**
+    *@param blockSize Size of each block in bytes.
+    *@param blocksPerChunk Count of blocks allocated at once when free list is empty.
+    */
+    CMemoryPool(u32 blockSize, u32 blocksPerChunk = 64);
+
+    ~CMemoryPool();
+
+    void* allocate();
+
+    void release(void* it);
+
+    u32 getBlockSize()const {
+        return mBlockSize;
+    }
+
+    /**
+    *@brief Allocate from the global pool of the nearest size class,
+    * sizes bigger than the max size class are allocated from heap.
+    *@param size Size in bytes.
+    */
+    static void* allocate(u32 size);
+
+    /**
+    *@brief Release memory allocated by allocate(size).
+    *@param it The memory.
+    *@param size The same size passed to allocate(size).
+    */
+    static void release(void* it, u32 size);
+
+private:
+    struct SBlock {
+        SBlock* mNext;
+    };
+
+    CMemoryPool(const CMemoryPool& it) = delete;
+    CMemoryPool& operator=(const CMemoryPool& it) = delete;
+
+    static CMemoryPool* getPool(u32 size);
+
+    u32 mBlockSize;
+    u32 mBlocksPerChunk;
+    SBlock* mFree;
+    SBlock* mChunks;
+    CSpinlock mLock;
+};
+
+}//irr
+
+#endif	/* APP_CMEMORYPOOL_H */
@@ -0,0 +1,203 @@
+/**
+*@file CParallelJob.h
+*@brief This file defined parallel-for and parallel-reduce on thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CPARALLELJOB_H
+#define APP_CPARALLELJOB_H
+
+#include "CThreadPool.h"
+#include "CSpinlock.h"
+#include "irrArray.h"
+
+namespace irr {
+
+/**
+*@class CParallelJob
+*@brief A job which splits range [begin, end) into chunks, and the chunks are
+* executed by the calling thread and helper tasks posted to a thread pool.
+* Chunk size adapts to the remaining range: remaining / (2 * participants),
+* but not less than grain, so big chunks are taken first and small chunks balance the tail.
+*@note The job lives on the caller's stack, no memory is allocated per chunk.
+*/
+class CParallelJob : public IRunnable {
+public:
+    /**
+    *@param pool The thread pool to post helper tasks.
+    *@param begin First index of range.
+    *@param end Last index of range + 1.
+    *@param grain Min count of indices in a chunk.
+    */
+    CParallelJob(CThreadPool& pool, s32 begin, s32 end, s32 grain);
+
+    virtual ~CParallelJob();
+
+    /**
+    *@brief Post helpers, work in the calling thread, and return after all helpers finished.
+    *@note The calling thread runs other waiting tasks of the pool while waiting.
+    * Helpers dropped by a stopped pool are cancelled, the calling thread does their chunks.
+    */
+    void execute();
+
+    /**
+    *@brief Helper task entry.
+    */
+    virtual void run()override;
+
+    /**
+    *@brief A helper dropped by pool, it took no chunk.
+    */
+    virtual void cancel()override;
+
+protected:
+    /**
+    *@brief Process chunks until no more, called by each participant.
+    */
+    virtual void work() = 0;
+
+    /**
+    *@brief Take next chunk.
+    *@return false if no more chunks.
+    */
+    bool next(s32& begin, s32& end);
+
+private:
+    CParallelJob(const CParallelJob& it) = delete;
+    CParallelJob& operator=(const CParallelJob& it) = delete;
+
+    CThreadPool& mPool;
+    s32 mNext;
+    s32 mEnd;
+    s32 mGrain;
+    s32 mDivisor;
+    s32 mPending;   ///<helpers not finished
+};
+
+
+template<class TFunction>
+class CParallelForJob : public CParallelJob {
+public:
+    CParallelForJob(CThreadPool& pool, s32 begin, s32 end, s32 grain, TFunction& func) :
+        CParallelJob(pool, begin, end, grain),
+        mFunction(func) {
+    }
+
+protected:
+    virtual void work()override {
+        s32 begin, end;
+        while(next(begin, end)) {
+            for(; begin < end; ++begin) {
+                mFunction(begin);
+            }
+        }
+    }
+
+private:
+    TFunction& mFunction;
+};
+
+
+template<class T, class TMap, class TCombine>
+class CParallelReduceJob : public CParallelJob {
+public:
+    CParallelReduceJob(CThreadPool& pool, s32 begin, s32 end, s32 grain,
+        const T& identity, TMap& map, TCombine& combine) :
+        CParallelJob(pool, begin, end, grain),
+        mIdentity(identity),
+        mResult(identity),
+        mMap(map),
+        mCombine(combine) {
+    }
+
+    const T& getResult()const {
+        return mResult;
+    }
+
+protected:
+    virtual void work()override {
+        s32 begin, end;
+        T local(mIdentity);
+        bool worked = false;
+        while(next(begin, end)) {
+            worked = true;
+            for(; begin < end; ++begin) {
+                local = mCombine(local, mMap(begin));
+            }
+        }
+        if(worked) {
+            CAutoSpinlock ak(mLock);
+            mResult = mCombine(mResult, local);
+        }
+    }
+
+private:
+    const T& mIdentity;
+    T mResult;
+    TMap& mMap;
+    TCombine& mCombine;
+    CSpinlock mLock;
+};
+
+
+/**
+*@brief Call func(i) for each i in [begin, end), in parallel.
+*@param pool The thread pool to help.
+*@param begin First index.
+*@param end Last index + 1.
+*@param grain Min count of indices per chunk.
+*@param func Callable as func(s32).
+*/
+template<class TFunction>
+void AppParallelFor(CThreadPool& pool, s32 begin, s32 end, s32 grain, TFunction func) {
+    CParallelForJob<TFunction> job(pool, begin, end, grain, func);
+    job.execute();
+}
+
+
+/**
+*@brief Call func(item) for each item of array, in parallel.
+*@param func Callable as func(T&).
+*/
+template<class T, class TAlloc, class TFunction>
+void AppParallelFor(CThreadPool& pool, core::array<T, TAlloc>& items, s32 grain, TFunction func) {
+    auto call = [&items, &func](s32 i) {
+        func(items[i]);
+    };
+    AppParallelFor(pool, 0, (s32) items.size(), grain, call);
+}
+
+
+/**
+*@brief Reduce map(i) of each i in [begin, end) by combine, in parallel.
+*@param identity The identity value of combine.
+*@param map Callable as T map(s32).
+*@param combine Callable as T combine(const T&, const T&), must be associative and commutative.
+*@return The reduced value.
+*/
+template<class T, class TMap, class TCombine>
+T AppParallelReduce(CThreadPool& pool, s32 begin, s32 end, s32 grain,
+    const T& identity, TMap map, TCombine combine) {
+    CParallelReduceJob<T, TMap, TCombine> job(pool, begin, end, grain, identity, map, combine);
+    job.execute();
+    return job.getResult();
+}
+
+
+/**
+*@brief Reduce map(item) of each item of array by combine, in parallel.
+*@param map Callable as T map(const E&).
+*/
+template<class T, class E, class TAlloc, class TMap, class TCombine>
+T AppParallelReduce(CThreadPool& pool, const core::array<E, TAlloc>& items, s32 grain,
+    const T& identity, TMap map, TCombine combine) {
+    auto call = [&items, &map](s32 i) -> T {
+        return map(items[i]);
+    };
+    return AppParallelReduce(pool, 0, (s32) items.size(), grain, identity, call, combine);
+}
+
+}//irr
+
+#endif	/* APP_CPARALLELJOB_H */
@@ -0,0 +1,86 @@
+/**
+*@file CReadMostlyLock.h
+*@brief This file defined a distributed read/write locker for read-mostly data.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CREADMOSTLYLOCK_H
+#define APP_CREADMOSTLYLOCK_H
+
+#include "CReadWriteLock.h"
+
+namespace irr {
+
+/**
+*@class CReadMostlyLock
+*@brief A reader writer lock with reader counters spread over cache-line padded slots.
+* Each thread counts its reads in its own slot, so readers never write a shared line
+* and don't slow down each other. A writer blocks new readers, then waits all slots drain.
+* Works with CAutoLockRead, CAutoLockWrite, CAutoLockTryRead and CAutoLockTryWrite.
+*@note Writing costs a scan of all slots, use it for data written rarely,
+* eg: configs and routing tables. Waiters spin and yield, hold the write lock shortly.
+* Not recursive, can't be used with CCondition.
+*/
+class CReadMostlyLock {
+public:
+    /**
+    *@param slots Count of reader slots, rounded up to power of 2,
+    * 0 means the processor count. Threads are spread over slots by round robin.
+    */
+    CReadMostlyLock(u32 slots = 0);
+
+    ~CReadMostlyLock();
+
+    /**
+    *@brief Acquires a read lock, waits if a writer holds or is waiting for the lock.
+    */
+    void lockRead();
+
+    /**
+    *@brief Acquires a write lock, waits until other writers and all readers leave.
+    */
+    void lockWrite();
+
+    /**
+    *@return false if a writer holds or is waiting for the lock.
+    */
+    bool tryLockRead();
+
+    /**
+    *@return false if other threads hold the lock.
+    */
+    bool tryLockWrite();
+
+    void unlockRead();
+
+    void unlockWrite();
+
+    u32 getSlotCount()const {
+        return mMask + 1;
+    }
+
+private:
+    CReadMostlyLock(const CReadMostlyLock& it) = delete;
+    CReadMostlyLock& operator=(const CReadMostlyLock& it) = delete;
+
+    struct SSlot {
+        s32 mReaders;
+        s8 mPadding[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    };
+
+    ///reader slot of current thread
+    SSlot& getSlot();
+
+    ///wait until no reader left in all slots, call with writer flag set.
+    void waitReaders();
+
+    s32 mWriter;        ///<1 if a writer holds or waits for lock
+    u32 mMask;
+    SSlot* mSlots;      ///<aligned to cache line
+    s8* mBuffer;
+};
+
+}//irr
+
+#endif	/* APP_CREADMOSTLYLOCK_H */
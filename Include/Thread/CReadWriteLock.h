@@ -81,57 +81,85 @@ private:
 };
 
 
+/**
+*@brief Scoped locks of CReadWriteLock, CReadMostlyLock, or any lock with
+* lockRead(), lockWrite(), tryLockRead(), tryLockWrite(), unlockRead() and unlockWrite().
+*/
 class CAutoLockWrite {
 public:
-    CAutoLockWrite(CReadWriteLock& pLock) : mLock(pLock) {
-        mLock.lockWrite();
+    template<class T>
+    CAutoLockWrite(T& pLock) : mLock(&pLock), mUnlock(&CAutoLockWrite::unlock<T>) {
+        pLock.lockWrite();
     }
     ~CAutoLockWrite() {
-        mLock.unlockWrite();
+        mUnlock(mLock);
     }
 private:
-    CReadWriteLock& mLock;
+    template<class T>
+    static void unlock(void* it) {
+        ((T*) it)->unlockWrite();
+    }
+    void* mLock;
+    void (*mUnlock)(void*);
 };
 
 class CAutoLockTryWrite {
 public:
-    CAutoLockTryWrite(CReadWriteLock& pLock) : mLock(pLock) {
-        mSuccess = mLock.tryLockWrite();
+    template<class T>
+    CAutoLockTryWrite(T& pLock) : mLock(&pLock), mUnlock(&CAutoLockTryWrite::unlock<T>) {
+        mSuccess = pLock.tryLockWrite();
     }
     ~CAutoLockTryWrite() {
         if(mSuccess) {
-            mLock.unlockWrite();
+            mUnlock(mLock);
         }
     }
 private:
-    CReadWriteLock& mLock;
+    template<class T>
+    static void unlock(void* it) {
+        ((T*) it)->unlockWrite();
+    }
+    void* mLock;
+    void (*mUnlock)(void*);
     bool mSuccess;
 };
 
 class CAutoLockRead {
 public:
-    CAutoLockRead(CReadWriteLock& pLock) : mLock(pLock) {
-        mLock.lockRead();
+    template<class T>
+    CAutoLockRead(T& pLock) : mLock(&pLock), mUnlock(&CAutoLockRead::unlock<T>) {
+        pLock.lockRead();
     }
     ~CAutoLockRead() {
-        mLock.unlockRead();
+        mUnlock(mLock);
     }
 private:
-    CReadWriteLock& mLock;
+    template<class T>
+    static void unlock(void* it) {
+        ((T*) it)->unlockRead();
+    }
+    void* mLock;
+    void (*mUnlock)(void*);
 };
 
 class CAutoLockTryRead {
 public:
-    CAutoLockTryRead(CReadWriteLock& pLock) : mLock(pLock) {
-        mSuccess = mLock.tryLockRead();
+    template<class T>
+    CAutoLockTryRead(T& pLock) : mLock(&pLock), mUnlock(&CAutoLockTryRead::unlock<T>) {
+        mSuccess = pLock.tryLockRead();
     }
     ~CAutoLockTryRead() {
         if(mSuccess) {
-            mLock.unlockRead();
+            mUnlock(mLock);
         }
     }
 private:
-    CReadWriteLock& mLock;
+    template<class T>
+    static void unlock(void* it) {
+        ((T*) it)->unlockRead();
+    }
+    void* mLock;
+    void (*mUnlock)(void*);
     bool mSuccess;
 };
 
@@ -0,0 +1,188 @@
+/**
+*@file CSeqLock.h
+*@brief This file defined a sequence lock for small POD snapshots.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CSEQLOCK_H
+#define APP_CSEQLOCK_H
+
+#include "HConfig.h"
+#include "irrTypes.h"
+#include <type_traits>
+
+namespace irr {
+
+/**
+*@class CSeqLock
+*@brief A sequence lock, the sequence is odd while writing.
+* Writers are exclusive by switching the sequence from even to odd, readers never
+* write the lock, they copy the payload and retry if the sequence changed meanwhile.
+* usage of reader:
+*@code
+*   u32 seq;
+*   do {
+*       seq = lock.beginRead();
+*       CSeqLock::copy(&snapshot, &shared);
+*   } while(!lock.endRead(seq));
+*@endcode
+*@note The payload must be trivially copyable and be accessed by copy() inside
+* the lock, or by read() and write(), so the racing copies are atomic per word.
+* Readers may starve if writers never stop, hold the write lock shortly.
+*/
+class CSeqLock {
+public:
+    CSeqLock() : mSequence(0) {
+    }
+
+    ~CSeqLock() {
+    }
+
+    /**
+    *@brief Begin a read, waits if a writer holds the lock.
+    *@return The even sequence to pass to endRead().
+    */
+    u32 beginRead()const;
+
+    /**
+    *@return true if no writer changed the payload since beginRead(), else retry.
+    */
+    bool endRead(u32 sequence)const;
+
+    void lockWrite();
+
+    /**
+    *@return false if another writer holds the lock.
+    */
+    bool tryLockWrite();
+
+    void unlockWrite();
+
+    /**
+    *@return Current sequence, count of finished writes is (sequence / 2).
+    */
+    u32 getSequence()const;
+
+    /**
+    *@brief Copy a consistent snapshot of src to dst, src is guarded by this lock.
+    */
+    template<class T>
+    void read(const T& src, T& dst)const {
+        u32 seq;
+        do {
+            seq = beginRead();
+            copy(&dst, &src);
+        } while(!endRead(seq));
+    }
+
+    /**
+    *@brief Copy src to dst under the write lock, dst is guarded by this lock.
+    */
+    template<class T>
+    void write(T& dst, const T& src) {
+        lockWrite();
+        copy(&dst, &src);
+        unlockWrite();
+    }
+
+    /**
+    *@brief Copy payload by relaxed atomic words (and bytes for the tail or unaligned type),
+    * a racing reader may see a torn payload, but never a torn word.
+    */
+    template<class T>
+    static void copy(T* dst, const T* src) {
+        static_assert(std::is_trivially_copyable<T>::value, "CSeqLock payload must be trivially copyable");
+        u32 pos = 0;
+        if(0 == alignof(T) % sizeof(s32)) {
+            for(; pos + sizeof(s32) <= sizeof(T); pos += sizeof(s32)) {
+                storeRelaxed((s32*) ((s8*) dst + pos), loadRelaxed((const s32*) ((const s8*) src + pos)));
+            }
+        }
+        for(; pos < sizeof(T); ++pos) {
+            storeRelaxed((s8*) dst + pos, loadRelaxed((const s8*) src + pos));
+        }
+    }
+
+private:
+    CSeqLock(const CSeqLock& it) = delete;
+    CSeqLock& operator=(const CSeqLock& it) = delete;
+
+    template<class V>
+    static V loadRelaxed(const V* it) {
+#if defined(APP_PLATFORM_WINDOWS)
+        return *(const volatile V*) it;
+#else
+        return __atomic_load_n(it, __ATOMIC_RELAXED);
+#endif
+    }
+
+    template<class V>
+    static void storeRelaxed(V* it, V value) {
+#if defined(APP_PLATFORM_WINDOWS)
+        *(volatile V*) it = value;
+#else
+        __atomic_store_n(it, value, __ATOMIC_RELAXED);
+#endif
+    }
+
+    s32 mSequence;
+};
+
+
+/**
+*@class CSeqValue
+*@brief A small POD value guarded by a CSeqLock, eg: clocks, counters and stats.
+* get() never writes shared memory, set() is exclusive between writers.
+*/
+template<class T>
+class CSeqValue {
+public:
+    CSeqValue() : mValue() {
+    }
+
+    explicit CSeqValue(const T& it) : mValue(it) {
+    }
+
+    T get()const {
+        T ret;
+        mLock.read(mValue, ret);
+        return ret;
+    }
+
+    void get(T& it)const {
+        mLock.read(mValue, it);
+    }
+
+    void set(const T& it) {
+        mLock.write(mValue, it);
+    }
+
+    /**
+    *@brief Modify the value in place by func(T&), under the write lock.
+    */
+    template<class F>
+    void update(F func) {
+        mLock.lockWrite();
+        T it;
+        CSeqLock::copy(&it, &mValue);
+        func(it);
+        CSeqLock::copy(&mValue, &it);
+        mLock.unlockWrite();
+    }
+
+    CSeqLock& getLock() {
+        return mLock;
+    }
+
+private:
+    CSeqValue(const CSeqValue& it) = delete;
+    CSeqValue& operator=(const CSeqValue& it) = delete;
+
+    CSeqLock mLock;
+    T mValue;
+};
+
+}//irr
+
+#endif	/* APP_CSEQLOCK_H */
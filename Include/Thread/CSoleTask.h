@@ -0,0 +1,66 @@
+/**
+*@file CSoleTask.h
+*@brief This file defined a coalescing task of thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CSOLETASK_H
+#define APP_CSOLETASK_H
+
+#include "CThreadPool.h"
+
+namespace irr {
+
+/**
+*@class CSoleTask
+*@brief A task which is posted to pool at most once while pending,
+* signals before it runs are coalesced into one run, eg: flush dirty state.
+* The pending flag is cleared before the target runs, so a signal raised
+* while running schedules one more run, and no signal is lost.
+* Signal path takes no lock, a pool can have any count of sole tasks.
+*@note Don't destroy it while pending.
+*/
+class CSoleTask : public IRunnable {
+public:
+    CSoleTask(CThreadPool& pool, AppCallable iFunc, void* iData = 0, ETaskPriority iPriority = ETP_NORMAL);
+
+    CSoleTask(CThreadPool& pool, IRunnable* it, ETaskPriority iPriority = ETP_NORMAL);
+
+    virtual ~CSoleTask();
+
+    /**
+    *@brief Schedule the target if not pending.
+    *@return false if the pool rejected it, true if posted or already pending.
+    */
+    bool signal();
+
+    bool isPending()const;
+
+    /**
+    *@return Signals coalesced since last run, it's reset when the target starts.
+    */
+    u32 getSignals()const;
+
+    virtual void run()override;
+
+    /**
+    *@brief Dropped by pool, clear the pending flag so the next signal posts it again.
+    * The target is kept, it's not cancelled.
+    */
+    virtual void cancel()override;
+
+private:
+    CSoleTask(const CSoleTask& it) = delete;
+    CSoleTask& operator=(const CSoleTask& it) = delete;
+
+    s32 mPending;
+    s32 mSignals;
+    CThreadPool& mPool;
+    ETaskPriority mPriority;
+    SThreadTask mTarget;
+};
+
+}//irr
+
+#endif	/* APP_CSOLETASK_H */
@@ -6,8 +6,10 @@
 namespace irr {
 
 /**
-* @brief a spinlock base on atomic operations.
-* @note Do't use spinlock on mononuclear CPU, or havy calculation tasks.
+* @brief a spinlock base on atomic operations, test-and-test-and-set with exponential backoff.
+* Waiters spin on a plain read with CPU pause, CAS only when the lock looks free,
+* and yield CPU when the holder is slow, so it's also safe on mononuclear CPU.
+* @note Not fair, use CTicketLock or CMCSLock for heavy contended locks.
 * CSpinlock is not recursive lock.
 */
 class CSpinlock {
@@ -38,6 +40,66 @@ private:
 };
 
 
+/**
+* @brief a fair spinlock, threads get the lock in the order of calling lock().
+* Waiters back off in proportion to their distance from the holder.
+* @note All waiters spin on the same cache line, prefer CMCSLock on many cores.
+* Not recursive.
+*/
+class CTicketLock {
+public:
+    CTicketLock();
+
+    ~CTicketLock();
+
+    void lock();
+
+    /**
+    * @return false if the lock is held or has waiters.
+    */
+    bool trylock();
+
+    void unlock();
+
+private:
+    s32 mNext;          ///<next ticket to take
+    s32 mServing;       ///<ticket of the holder
+    CTicketLock(const CTicketLock& it) = delete;
+    CTicketLock& operator=(const CTicketLock& it) = delete;
+};
+
+
+/**
+* @brief a fair queue spinlock (Mellor-Crummey and Scott), each waiter spins on
+* its own cache line, so a release only touches the next waiter.
+* Queue nodes are cached per thread, lock() allocates none after warming up.
+* @note unlock() must be called by the locking thread. Not recursive.
+*/
+class CMCSLock {
+public:
+    CMCSLock();
+
+    ~CMCSLock();
+
+    void lock();
+
+    /**
+    * @return false if the lock is held or has waiters.
+    */
+    bool trylock();
+
+    void unlock();
+
+    struct SNode;
+
+private:
+    void* mTail;        ///<the last waiter, null if unlocked
+    SNode* mHolder;     ///<node of holder, only used by holder
+    CMCSLock(const CMCSLock& it) = delete;
+    CMCSLock& operator=(const CMCSLock& it) = delete;
+};
+
+
 
 class CAutoSpinlock {
 public:
@@ -54,6 +116,23 @@ private:
 };
 
 
+///scoped lock of CTicketLock, CMCSLock, or any lock with lock() and unlock()
+template<class T>
+class CAutoSpinlockT {
+public:
+    CAutoSpinlockT(T& it) : mLock(it) {
+        mLock.lock();
+    }
+
+    ~CAutoSpinlockT() {
+        mLock.unlock();
+    }
+
+private:
+    T& mLock;
+};
+
+
 } //namespace irr
 
 #endif //APP_CSPINLOCK_H
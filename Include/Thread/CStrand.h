@@ -0,0 +1,116 @@
+/**
+*@file CStrand.h
+*@brief This file defined a serial executor on thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CSTRAND_H
+#define APP_CSTRAND_H
+
+#include "CThreadPool.h"
+
+namespace irr {
+
+/**
+*@class CStrand
+*@brief Tasks posted to a strand run one by one in posted order, tasks of
+* different strands run in parallel on the shared pool, eg: a strand per connection.
+* The strand is scheduled to pool only when its first task is posted, and a
+* scheduled run drains a batch of tasks on the same worker.
+* Tasks are linked in an intrusive MPSC queue, linking is lock free, and the
+* nodes are recycled by a lock free cache of the strand, not allocated per post.
+*@note If the pool rejects the strand, the tasks are run in posting thread.
+* If the pool drops the strand when stopped, the waiting tasks are discarded.
+* Don't destroy it while tasks are pending.
+*/
+class CStrand : public IRunnable {
+public:
+    /**
+    *@param pool The pool to run on.
+    *@param batch Max tasks run in a schedule, the strand is posted again if more
+    * tasks left, so other strands are not starved.
+    *@param iPriority Priority of the strand in pool.
+    */
+    CStrand(CThreadPool& pool, u32 batch = 32, ETaskPriority iPriority = ETP_NORMAL);
+
+    virtual ~CStrand();
+
+    bool post(AppCallable iFunc, void* iData = 0);
+
+    bool post(IRunnable* it);
+
+    bool post(CTask&& it);
+
+    /**
+    *@return Approximate count of tasks waiting or running.
+    */
+    u32 getWaitingTasks()const;
+
+    CThreadPool& getPool()const {
+        return mPool;
+    }
+
+    virtual void run()override;
+
+    virtual void cancel()override;
+
+    ///a task linked in the queue
+    struct SNode {
+        SThreadTask mTask;
+        SNode* mNext;
+
+        SNode() : mNext(0) {
+        }
+    };
+
+private:
+    enum {
+        ECACHE_SIZE = 16    ///<max free nodes kept by a strand
+    };
+
+    CStrand(const CStrand& it) = delete;
+    CStrand& operator=(const CStrand& it) = delete;
+
+    bool post(SThreadTask&& it);
+
+    /**
+    *@brief Get a node from cache, or new one if cache is empty.
+    * A slot is taken by exchange, so poppers have no ABA problem.
+    */
+    SNode* createNode();
+
+    ///put a node to cache by the consumer, or delete it if cache is full.
+    void releaseNode(SNode* it);
+
+    void push(SNode* it);
+
+    ///pop by the running worker only
+    SNode* pop();
+
+    /**
+    *@brief Pop a task promised by mCount, wait if it's in linking.
+    *@return The task, its node is released.
+    */
+    SThreadTask take();
+
+    /**
+    *@brief Run tasks of a batch, then post the strand again if tasks left.
+    *@return false if tasks left but pool rejected the strand.
+    */
+    bool drain();
+
+    s32 mCount;         ///<tasks posted and not finished
+    u32 mBatch;
+    ETaskPriority mPriority;
+    CThreadPool& mPool;
+    SNode* mHead;       ///<consumer side
+    s8 mPadding0[APP_CACHE_LINE_SIZE];
+    SNode* mTail;       ///<producers side
+    SNode mStub;
+    SNode* mCache[ECACHE_SIZE];     ///<free nodes, 0 if empty slot
+};
+
+}//irr
+
+#endif	/* APP_CSTRAND_H */
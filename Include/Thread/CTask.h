@@ -0,0 +1,199 @@
+/**
+*@file CTask.h
+*@brief This file defined a move-only task which stores functors.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CTASK_H
+#define APP_CTASK_H
+
+#include "CThread.h"
+#include "CMemoryPool.h"
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace irr {
+
+///where a functor is stored in SThreadTask
+enum ETaskStore {
+    ETS_INLINE = 0,     ///<inline, copied by bytes
+    ETS_MOVE,           ///<inline, moved by its manager
+    ETS_POOL            ///<in a block of CMemoryPool
+};
+
+
+/**
+*@brief Small functors are stored inline, a trivially copyable one is copied
+* by bytes, others are moved by the manager when the task is copied. A big functor,
+* or one which may throw in moving, is moved to a block of CMemoryPool.
+*/
+template<class F>
+struct STaskStore {
+    static const bool EFIT = sizeof(F) <= sizeof(SThreadTask::SFunctorData::mBuffer)
+        && alignof(F) <= alignof(void*);
+    static const ETaskStore ETYPE = !EFIT ? ETS_POOL
+        : std::is_trivially_copyable<F>::value ? ETS_INLINE
+        : std::is_nothrow_move_constructible<F>::value ? ETS_MOVE : ETS_POOL;
+};
+
+
+template<class F, ETaskStore TStore = STaskStore<F>::ETYPE>
+struct STaskFunctor;
+
+
+template<class F>
+struct STaskFunctor<F, ETS_INLINE> {
+    ///@return Type of the task.
+    template<class A>
+    static s32 create(SThreadTask::SFunctorData& it, A&& func) {
+        new (it.mBuffer) F(std::forward<A>(func));
+        it.mManage = STaskFunctor::manage;
+        return SThreadTask::ETT_FUNCTOR;
+    }
+
+    static void manage(SThreadTask::EFunctorOperation op, SThreadTask::SFunctorData& it, SThreadTask::SFunctorData*) {
+        F& func = *(F*) it.mBuffer;
+        if(SThreadTask::EFO_RUN == op) {
+            func();
+        }
+        func.~F();
+    }
+};
+
+
+template<class F>
+struct STaskFunctor<F, ETS_MOVE> {
+    template<class A>
+    static s32 create(SThreadTask::SFunctorData& it, A&& func) {
+        new (it.mBuffer) F(std::forward<A>(func));
+        it.mManage = STaskFunctor::manage;
+        return SThreadTask::ETT_FUNCTOR_MOVE;
+    }
+
+    static void manage(SThreadTask::EFunctorOperation op, SThreadTask::SFunctorData& it, SThreadTask::SFunctorData* from) {
+        F& func = *(F*) it.mBuffer;
+        switch(op) {
+        case SThreadTask::EFO_RUN:
+            func();
+            func.~F();
+            break;
+        case SThreadTask::EFO_DESTROY:
+            func.~F();
+            break;
+        case SThreadTask::EFO_MOVE:
+        {
+            F& src = *(F*) from->mBuffer;
+            new (it.mBuffer) F(std::move(src));
+            src.~F();
+            break;
+        }
+        case SThreadTask::EFO_BOX:
+        {
+            F* block = new (CMemoryPool::allocate(sizeof(F))) F(std::move(func));
+            func.~F();
+            it.mBuffer[0] = block;
+            it.mManage = STaskFunctor<F, ETS_POOL>::manage;
+            break;
+        }
+        }
+    }
+};
+
+
+template<class F>
+struct STaskFunctor<F, ETS_POOL> {
+    static_assert(alignof(F) <= CMemoryPool::EALIGN_SIZE,
+        "functor is allocated from CMemoryPool, over-aligned functor is not supported");
+
+    template<class A>
+    static s32 create(SThreadTask::SFunctorData& it, A&& func) {
+        it.mBuffer[0] = new (CMemoryPool::allocate(sizeof(F))) F(std::forward<A>(func));
+        it.mManage = STaskFunctor::manage;
+        return SThreadTask::ETT_FUNCTOR;
+    }
+
+    static void manage(SThreadTask::EFunctorOperation op, SThreadTask::SFunctorData& it, SThreadTask::SFunctorData*) {
+        F* func = (F*) it.mBuffer[0];
+        if(SThreadTask::EFO_RUN == op) {
+            (*func)();
+        }
+        func->~F();
+        CMemoryPool::release(func, sizeof(F));
+    }
+};
+
+
+/**
+*@class CTask
+*@brief A move-only task of a functor, eg: a lambda with captures.
+* Small functors are stored inline, no allocation, see STaskStore.
+*@note The functor is destroyed after run, or when the task is destroyed without run.
+*/
+class CTask {
+public:
+    CTask() {
+    }
+
+    /**
+    *@param func Callable as void func().
+    */
+    template<class F, class = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, CTask>::value,
+        decltype((*(typename std::decay<F>::type*) 0)(), void())>::type>
+    CTask(F&& func) {
+        mTask.mType = STaskFunctor<typename std::decay<F>::type>::create(mTask.mTarget.mFunctor, std::forward<F>(func));
+    }
+
+    CTask(CTask&& it) : mTask(std::move(it.mTask)) {
+    }
+
+    ~CTask() {
+        mTask.discard();
+    }
+
+    CTask& operator=(CTask&& it) {
+        if(this != &it) {
+            mTask.discard();
+            mTask = std::move(it.mTask);
+        }
+        return *this;
+    }
+
+    bool isValid()const {
+        return SThreadTask::ETT_NONE != mTask.mType;
+    }
+
+    /**
+    *@brief Run the task in current thread, the task is empty after run.
+    */
+    void operator()() {
+        SThreadTask task(std::move(mTask));
+        task();
+    }
+
+    /**
+    *@note Move the returned task to take the functor away, don't copy it.
+    */
+    SThreadTask& getTask() {
+        return mTask;
+    }
+
+    /**
+    *@brief Give up the functor, the owner of returned task must run or discard it.
+    */
+    SThreadTask release() {
+        return std::move(mTask);
+    }
+
+private:
+    CTask(const CTask& it) = delete;
+    CTask& operator=(const CTask& it) = delete;
+
+    SThreadTask mTask;
+};
+
+}//irr
+
+#endif	/* APP_CTASK_H */
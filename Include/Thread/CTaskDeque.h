@@ -0,0 +1,79 @@
+/**
+*@file CTaskDeque.h
+*@brief This file defined a bounded work-stealing deque of thread tasks.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CTASKDEQUE_H
+#define APP_CTASKDEQUE_H
+
+#include "CThread.h"
+
+namespace irr {
+
+/**
+*@class CTaskDeque
+*@brief A bounded Chase-Lev deque, tasks are stored by value.
+* The owner thread pushes and pops at the bottom (LIFO),
+* other threads steal from the top (FIFO).
+* A thief reads a task by bytes before it owns the task, so a functor moved by
+* its manager is boxed to CMemoryPool when pushed, see SThreadTask::box().
+*@note Call init() before use, push() and pop() must only be called by the owner thread.
+*/
+class CTaskDeque {
+public:
+    CTaskDeque();
+
+    ~CTaskDeque();
+
+    /**
+    *@brief Allocate slots, all tasks in deque will be discarded.
+    *@param capacity Max tasks in deque, rounded up to power of 2.
+    *@note Not safe against steal(), init it before other threads can see the deque.
+    */
+    void init(u32 capacity);
+
+    /**
+    *@brief Push a task at bottom, owner only, it's moved only if pushed.
+    *@return false if deque is full.
+    */
+    bool push(SThreadTask&& it);
+
+    /**
+    *@brief Pop the newest task from bottom, owner only.
+    *@return false if deque is empty.
+    */
+    bool pop(SThreadTask& it);
+
+    /**
+    *@brief Steal the oldest task from top, any thread.
+    *@return false if deque is empty or lost the race with other thieves.
+    */
+    bool steal(SThreadTask& it);
+
+    /**
+    *@return Approximate count of tasks in deque.
+    */
+    u32 size()const;
+
+    u32 getCapacity()const {
+        return mMask + 1;
+    }
+
+private:
+    CTaskDeque(const CTaskDeque& it) = delete;
+    CTaskDeque& operator=(const CTaskDeque& it) = delete;
+
+    ///top and bottom are kept in different cache lines.
+    s32 mTop;
+    s8 mPadding0[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    s32 mBottom;
+    s8 mPadding1[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    u32 mMask;
+    SThreadTask* mTasks;
+};
+
+}//irr
+
+#endif	/* APP_CTASKDEQUE_H */
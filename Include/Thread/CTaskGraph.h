@@ -0,0 +1,139 @@
+/**
+*@file CTaskGraph.h
+*@brief This file defined a dependency graph of tasks executed by thread pool.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CTASKGRAPH_H
+#define APP_CTASKGRAPH_H
+
+#include "CThreadPool.h"
+#include "irrArray.h"
+
+namespace irr {
+
+/**
+*@class CTaskGraph
+*@brief A directed acyclic graph of tasks.
+* A node is posted to the pool when all of its predecessors finished,
+* the worker which finished the last predecessor posts it, so in
+* ETPM_WORK_STEALING mode it goes to the worker's own deque.
+* The graph can be launched again after finished, it's not rebuilt per frame.
+* If the pool drops a node, eg: the pool is stopped, the rest of the run is
+* cancelled, the nodes are finished without running their tasks.
+*@note Don't change the graph while it's running.
+*/
+class CTaskGraph {
+public:
+    enum {
+        ENODE_INVALID = 0xFFFFFFFF
+    };
+
+    CTaskGraph();
+
+    ~CTaskGraph();
+
+    /**
+    *@return The node ID, or ENODE_INVALID if failed.
+    */
+    u32 addNode(AppCallable iFunc, void* iData = 0);
+
+    /**
+    *@return The node ID, or ENODE_INVALID if failed.
+    */
+    u32 addNode(IRunnable* it);
+
+    /**
+    *@brief Node iTo can only start after node iFrom finished.
+    *@return false if the node IDs are invalid.
+    */
+    bool addEdge(u32 iFrom, u32 iTo);
+
+    /**
+    *@brief Remove all nodes and edges.
+    */
+    void clear();
+
+    u32 getNodeCount()const {
+        return mNodes.size();
+    }
+
+    /**
+    *@brief Post all root nodes to pool and return immediately.
+    *@return false if graph is running, empty, or has cycle.
+    */
+    bool launch(CThreadPool& pool);
+
+    /**
+    *@brief Wait until all nodes of the launched graph finished.
+    *@note The calling thread runs other waiting tasks of the pool, then sleeps
+    * until the last node finished.
+    */
+    void wait();
+
+    /**
+    *@brief Launch and wait.
+    *@return false if launch failed.
+    */
+    bool execute(CThreadPool& pool) {
+        if(!launch(pool)) {
+            return false;
+        }
+        wait();
+        return true;
+    }
+
+    bool isRunning()const;
+
+    /**
+    *@return true if the last run was cancelled, some tasks were not run.
+    */
+    bool isCancelled()const;
+
+private:
+    struct SNode : public IRunnable {
+        CTaskGraph* mGraph;
+        SNode* mNextReady;      ///<next node to run inline, rejected by pool
+        SThreadTask mTask;
+        s32 mPending;           ///<predecessors not finished in current run
+        u32 mPredecessors;
+        core::array<u32> mSuccessors;
+
+        virtual void run()override;
+
+        virtual void cancel()override;
+    };
+
+    CTaskGraph(const CTaskGraph& it) = delete;
+    CTaskGraph& operator=(const CTaskGraph& it) = delete;
+
+    u32 addNode(const SThreadTask& it);
+
+    bool checkCycle();
+
+    /**
+    *@brief Run the node, and the successors rejected by pool, by loop not by recursion.
+    */
+    void runReady(SNode* head);
+
+    /**
+    *@brief Post ready successors of node, and mark node finished.
+    *@param ready Nodes to run inline by caller.
+    *@return ready, with the successors rejected by pool.
+    */
+    SNode* onFinish(SNode& node, SNode* ready);
+
+    CThreadPool* mPool;
+    s32 mRemaining;             ///<nodes not finished in current run
+    s32 mActive;                ///<1 from launch() until the finisher left the graph
+    s32 mCancelled;             ///<1 if a node was dropped by pool in current run
+    bool mChecked;              ///<true if checked no cycle
+    bool mValid;
+    core::array<SNode*> mNodes;
+    CThreadEvent mFinished;
+};
+
+}//irr
+
+#endif	/* APP_CTASKGRAPH_H */
@@ -0,0 +1,83 @@
+/**
+*@file CTaskRing.h
+*@brief This file defined a lock-free bounded queue of thread tasks.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CTASKRING_H
+#define APP_CTASKRING_H
+
+#include "CThread.h"
+
+namespace irr {
+
+/**
+*@class CTaskRing
+*@brief A lock-free bounded multi-producer/multi-consumer ring queue.
+* Tasks are stored by value in cells, each cell has a sequence number
+* which tells producers and consumers whether the cell is ready for them,
+* so no memory is allocated when push or pop.
+*@note Call init() before use.
+*/
+class CTaskRing {
+public:
+    CTaskRing();
+
+    ~CTaskRing();
+
+    /**
+    *@brief Allocate cells, all tasks in queue will be discarded.
+    *@param capacity Max tasks in queue, rounded up to power of 2.
+    */
+    void init(u32 capacity);
+
+    /**
+    *@brief Push a task, it's moved only if pushed.
+    *@return false if queue is full.
+    */
+    bool push(SThreadTask&& it);
+
+    /**
+    *@brief Push a batch of tasks, reserve cells with a single CAS.
+    *@param tasks The tasks to push, copied by bytes, so they must not own functors.
+    *@param count Count of tasks.
+    *@return Count of pushed tasks, the tasks at tail are not pushed if queue is full.
+    */
+    u32 push(const SThreadTask* tasks, u32 count);
+
+    /**
+    *@return false if queue is empty.
+    */
+    bool pop(SThreadTask& it);
+
+    /**
+    *@return Approximate count of tasks in queue.
+    */
+    u32 size()const;
+
+    u32 getCapacity()const {
+        return mMask + 1;
+    }
+
+private:
+    struct SCell {
+        s32 mSequence;
+        SThreadTask mTask;
+    };
+
+    CTaskRing(const CTaskRing& it) = delete;
+    CTaskRing& operator=(const CTaskRing& it) = delete;
+
+    ///producers and consumers are kept in different cache lines.
+    s32 mPushPosition;
+    s8 mPadding0[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    s32 mPopPosition;
+    s8 mPadding1[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    u32 mMask;
+    SCell* mCells;
+};
+
+}//irr
+
+#endif	/* APP_CTASKRING_H */
@@ -10,6 +10,7 @@
 
 #include "HConfig.h"
 #include "irrString.h"
+#include "irrArray.h"
 #include "IRunnable.h"
 #include "CMutex.h"
 #include "CThreadEvent.h"
@@ -28,23 +29,38 @@ typedef void(*AppCallable)(void*);
 
 
 ///A callable task for threads.
+///It fits a cache line on 64-bit platforms.
 struct SThreadTask {
     enum ETaskType {
         ETT_NONE = 0,
         ETT_RUN,
-        ETT_CALL
+        ETT_CALL,
+        ETT_FUNCTOR,        ///<a functor which can be copied by bytes, inline or in CMemoryPool
+        ETT_FUNCTOR_MOVE    ///<an inline functor moved by its manager when the task is moved
+    };
+    enum EFunctorOperation {
+        EFO_RUN = 0,        ///<run and destroy
+        EFO_DESTROY,
+        EFO_MOVE,           ///<move construct from the source, and destroy the source
+        EFO_BOX             ///<move an inline functor to CMemoryPool
     };
     struct SCallbackData {
         AppCallable  mCallback;
         void* mData;
     };
+    ///a functor stored by CTask, inline or a pointer to a pooled one.
+    struct SFunctorData {
+        ///the manager of functor, from is the source of EFO_MOVE.
+        void(*mManage)(EFunctorOperation op, SFunctorData& it, SFunctorData* from);
+        void* mBuffer[(APP_TASK_INLINE_SIZE + sizeof(void*) - 1) / sizeof(void*)];
+    };
     union {
         IRunnable* mCaller; //ETT_RUN
         SCallbackData mCallFunction;//ETT_CALL
+        SFunctorData mFunctor;//ETT_FUNCTOR, ETT_FUNCTOR_MOVE
     } mTarget;
     s32 mType;
-    s32 mCount;
-    SThreadTask* mNext;
+    u32 mPostTime;  ///<microseconds when posted to pool, low 32 bits, 0 if not stamped
 
     SThreadTask() {
         clear();
@@ -53,27 +69,55 @@ struct SThreadTask {
     SThreadTask(IRunnable* target) {
         mType = SThreadTask::ETT_RUN;
         mTarget.mCaller = target;
-        mCount = 0;
-        mNext = 0;
+        mPostTime = 0;
     }
 
     SThreadTask(AppCallable iTarget, void* iData) {
         mType = SThreadTask::ETT_CALL;
         mTarget.mCallFunction.mCallback = iTarget;
         mTarget.mCallFunction.mData = iData;
-        mCount = 0;
-        mNext = 0;
+        mPostTime = 0;
     }
 
-    SThreadTask& operator=(const SThreadTask& it) {
+    /**
+    *@brief Copy a task by bytes, only for tasks which don't own a functor,
+    * eg: a runnable or a callback. Move a task of functor.
+    */
+    SThreadTask(const SThreadTask& it) {
+        APP_ASSERT(it.mType < ETT_FUNCTOR);
         ::memcpy(this, &it, sizeof(it));
+    }
+
+    ///Move a task, the source is left empty.
+    SThreadTask(SThreadTask&& it) {
+        take(it);
+    }
+
+    ///Copy a task by bytes, see SThreadTask(const SThreadTask&).
+    SThreadTask& operator=(const SThreadTask& it) {
+        APP_ASSERT(it.mType < ETT_FUNCTOR);
+        if(this != &it) {
+            destroy();
+            ::memcpy(this, &it, sizeof(it));
+        }
+        return *this;
+    }
+
+    /**
+    *@brief Move a task, the source is left empty.
+    *@note A functor still owned by this task is destroyed without run.
+    */
+    SThreadTask& operator=(SThreadTask&& it) {
+        if(this != &it) {
+            destroy();
+            take(it);
+        }
         return *this;
     }
 
     SThreadTask& operator=(IRunnable& target) {
         mType = SThreadTask::ETT_RUN;
         mTarget.mCaller = &target;
-        mCount = 1;
         return *this;
     }
 
@@ -81,7 +125,6 @@ struct SThreadTask {
         mType = SThreadTask::ETT_CALL;
         mTarget.mCallFunction.mCallback = iTarget;
         mTarget.mCallFunction.mData = iData;
-        mCount = 1;
         return *this;
     }
 
@@ -89,12 +132,60 @@ struct SThreadTask {
         ::memset(this, 0, sizeof(SThreadTask));
     }
 
+    /**
+    *@brief Move an ETT_FUNCTOR_MOVE functor to CMemoryPool, so the task can be copied by
+    * bytes, eg: read by a thief of a deque before it owns the task.
+    */
+    void box() {
+        if(ETT_FUNCTOR_MOVE == mType) {
+            mTarget.mFunctor.mManage(EFO_BOX, mTarget.mFunctor, 0);
+            mType = ETT_FUNCTOR;
+        }
+    }
+
+    /**
+    *@brief Run the task, a functor is destroyed after run, and the task is left empty.
+    */
     void operator()() {
         if(ETT_CALL == mType && mTarget.mCallFunction.mCallback) {
             mTarget.mCallFunction.mCallback(mTarget.mCallFunction.mData);
         } else if(ETT_RUN == mType && mTarget.mCaller) {
             mTarget.mCaller->run();
+        } else if(ETT_FUNCTOR == mType || ETT_FUNCTOR_MOVE == mType) {
+            mType = ETT_NONE;
+            mTarget.mFunctor.mManage(EFO_RUN, mTarget.mFunctor, 0);
+        }
+    }
+
+    /**
+    *@brief Drop a task which will never run, the functor is destroyed,
+    * and the runnable is cancelled.
+    */
+    void discard() {
+        if(ETT_FUNCTOR == mType || ETT_FUNCTOR_MOVE == mType) {
+            mTarget.mFunctor.mManage(EFO_DESTROY, mTarget.mFunctor, 0);
+        } else if(ETT_RUN == mType && mTarget.mCaller) {
+            mTarget.mCaller->cancel();
+        }
+        mType = ETT_NONE;
+    }
+
+private:
+    ///destroy the owned functor without run, a runnable is not cancelled.
+    void destroy() {
+        if(ETT_FUNCTOR == mType || ETT_FUNCTOR_MOVE == mType) {
+            mTarget.mFunctor.mManage(EFO_DESTROY, mTarget.mFunctor, 0);
+        }
+        mType = ETT_NONE;
+    }
+
+    ///take the task of source, this task must be empty.
+    void take(SThreadTask& it) {
+        ::memcpy(this, &it, sizeof(it));
+        if(ETT_FUNCTOR_MOVE == mType) {
+            mTarget.mFunctor.mManage(EFO_MOVE, mTarget.mFunctor, &it.mTarget.mFunctor);
         }
+        it.mType = ETT_NONE;
     }
 };
 
@@ -236,25 +327,49 @@ public:
     }
 
 
+    /**
+    *@brief Bind the thread to processors, it's applied before the thread runs if not started,
+    * so the stack is first touched on the local NUMA node.
+    *@param cpus Indices of processors.
+    *@param count Count of processors, 0 means no binding.
+    *@return false if failed to bind the running thread.
+    *@note Processors the process is not allowed to run on are ignored, the thread
+    * is not bound if none is allowed. On Windows, only processors in the group of cpus[0] are used.
+    */
+    bool setAffinity(const u32* cpus, u32 count);
+
+
+    bool setAffinity(u32 cpu) {
+        return setAffinity(&cpu, 1);
+    }
+
+
+    const core::array<u32>& getAffinity() const {
+        return mAffinity;
+    }
+
+
     /**
     *@brief Start the thread with the given target.
     *@param target The runnable target.
+    *@return false if failed to create the thread.
     *@note The given runnable target must be
     * valid during the entire lifetime of the thread, as
     * only a reference to it is stored internally.
     */
-    void start(IRunnable& target);
+    bool start(IRunnable& target);
 
 
     /**
     *@brief Start the thread with the given target and parameter.
     *@param target The runnable target.
     *@param iData The parameter for runnable target.
+    *@return false if failed to create the thread.
     *@note The given runnable target must be
     * valid during the entire lifetime of the thread, as
     * only a reference to it is stored internally.
     */
-    void start(AppCallable target, void* iData);
+    bool start(AppCallable target, void* iData);
 
 
     /**
@@ -326,6 +441,17 @@ public:
     static void yield();
 
 
+    /**
+    *@return Milliseconds of a monotonic clock, used to measure elapsed time.
+    */
+    static s64 getTickCount();
+
+    /**
+    *@return Nanoseconds of a monotonic high resolution clock, used to measure short intervals.
+    */
+    static s64 getTickNanoseconds();
+
+
     /**
     *@return The CThread object for the currently active thread, or 0 if
     * the current thread is the main thread.
@@ -339,6 +465,33 @@ public:
     static TID getCurrentNativeID();
 
 
+    /**
+    *@return Count of logical processors.
+    */
+    static u32 getProcessorCount();
+
+
+    /**
+    *@return Index of the processor which current thread is running on.
+    */
+    static u32 getCurrentProcessor();
+
+
+    /**
+    *@return Count of NUMA nodes, 1 if not a NUMA system.
+    */
+    static u32 getNumaNodeCount();
+
+
+    /**
+    *@brief Get processors of a NUMA node which the process is allowed to run on.
+    *@param node Index of node.
+    *@param cpus Output indices of processors, empty if none is allowed.
+    *@return false if node is invalid.
+    */
+    static bool getNumaNodeProcessors(u32 node, core::array<u32>& cpus);
+
+
 protected:
 
     /// Creates a unique name for a thread.
@@ -360,11 +513,14 @@ protected:
     static unsigned __stdcall callableEntry(void* iThread);
 #endif
 
-    void createThread(AppThreadEntry ent, void* iData);
+    bool createThread(AppThreadEntry ent, void* iData);
 
     void threadCleanup();
 #endif		//APP_PLATFORM_WINDOWS
 
+    ///bind the started thread to mAffinity.
+    bool applyAffinity();
+
 
 #if defined( APP_PLATFORM_ANDROID )  || defined( APP_PLATFORM_LINUX )
     static void* runnableEntry(void* iThread);
@@ -387,6 +543,7 @@ private:
     core::stringc mName;
     CThreadEvent mEvent;
     SThreadTask mTask;
+    core::array<u32> mAffinity;
 
 #if defined( APP_PLATFORM_WINDOWS )
     class CCurrentThreadHolder {
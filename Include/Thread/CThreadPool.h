@@ -10,53 +10,335 @@
 
 #include "irrList.h"
 #include "CThread.h"
-#include "CCondition.h"
+#include "CSpinlock.h"
+#include "CLatch.h"
+#include "CTaskRing.h"
+#include "CTask.h"
+#include "CTimerWheel.h"
+#include "CHistogram.h"
+#include "CThreadEvent.h"
 
 namespace irr {
 
+///Schedule mode of thread pool.
+enum EThreadPoolMode {
+    ///All workers share the global task queue.
+    ETPM_SHARED_QUEUE = 0,
+
+    ///Each worker owns a deque, tasks posted by workers are pushed to their own deque,
+    ///and idle workers steal from others. Tasks posted by outside threads go to the global queue.
+    ETPM_WORK_STEALING
+};
+
+///Placement of workers on processors.
+enum EThreadPlacement {
+    ///Workers are not bound, scheduled by OS.
+    ETPL_NONE = 0,
+
+    ///Worker i is bound to the ith processor, NUMA nodes are filled one by one.
+    ETPL_COMPACT,
+
+    ///Workers are bound to processors of NUMA nodes in turn, one processor per worker.
+    ETPL_SCATTER,
+
+    ///Workers are spread over NUMA nodes in turn, each is bound to all processors of its node.
+    ///Each node is a shard with its own global queues, tasks are posted to the queues of
+    ///poster's node, and workers pop from queues of their own node before other nodes.
+    ETPL_NUMA
+};
+
+///Priority of tasks, each priority has its own queue in thread pool.
+enum ETaskPriority {
+    ///Latency critical tasks, eg: control messages.
+    ETP_HIGH = 0,
+
+    ///Default priority, the only priority pushed to worker's local deque in work-stealing mode.
+    ETP_NORMAL,
+
+    ///Bulk jobs.
+    ETP_LOW,
+
+    ETP_COUNT
+};
+
+///Statistics of workers, times are in nanoseconds.
+///A worker writes its own counters by relaxed atomics, see AppCounterAdd().
+struct alignas(8) SThreadPoolStats {
+    u64 mTasks;         ///<tasks executed
+    u64 mSteals;        ///<tasks stolen from other workers
+    u64 mParks;         ///<times of parking
+    u64 mWakeups;       ///<times woken by producers when parked
+    u64 mBusyTime;      ///<time running tasks, timed only
+    u64 mIdleTime;      ///<time spinning, yielding and parked, timed only
+    u64 mParkTime;      ///<time parked, timed only
+    u32 mMaxDepth;      ///<max waiting tasks of pool seen by worker, sampled
+    CHistogram mWaitTime;   ///<from post to start of single posted tasks, timed only
+    CHistogram mRunTime;    ///<run time of tasks, timed only
+
+    SThreadPoolStats() {
+        clear();
+    }
+
+    void clear() {
+        mTasks = 0;
+        mSteals = 0;
+        mParks = 0;
+        mWakeups = 0;
+        mBusyTime = 0;
+        mIdleTime = 0;
+        mParkTime = 0;
+        mMaxDepth = 0;
+        mWaitTime.clear();
+        mRunTime.clear();
+    }
+
+    ///add the counters of it, which may be written by its worker.
+    void merge(const SThreadPoolStats& it) {
+        mTasks += AppAtomicLoadRelaxed(&it.mTasks);
+        mSteals += AppAtomicLoadRelaxed(&it.mSteals);
+        mParks += AppAtomicLoadRelaxed(&it.mParks);
+        mWakeups += AppAtomicLoadRelaxed(&it.mWakeups);
+        mBusyTime += AppAtomicLoadRelaxed(&it.mBusyTime);
+        mIdleTime += AppAtomicLoadRelaxed(&it.mIdleTime);
+        mParkTime += AppAtomicLoadRelaxed(&it.mParkTime);
+        const u32 depth = AppAtomicLoadRelaxed(&it.mMaxDepth);
+        mMaxDepth = depth > mMaxDepth ? depth : mMaxDepth;
+        mWaitTime.merge(it.mWaitTime);
+        mRunTime.merge(it.mRunTime);
+    }
+};
+
 /**
 *@class CThreadPool
 *@brief A thread pool work on Windows, Linux, and Android.
 */
 class CThreadPool : public IRunnable {
 public:
-    CThreadPool(u32 iThreadCount);
+    /**
+    *@param iThreadCount Max count of workers.
+    *@param iMode Schedule mode.
+    */
+    CThreadPool(u32 iThreadCount, EThreadPoolMode iMode = ETPM_SHARED_QUEUE);
 
     virtual ~CThreadPool();
 
     virtual void run()override;
 
     /**
-    *@param it 0: no limit
+    *@brief Set the capacity of global queue, tasks will be rejected if it's full.
+    *@param it 0: use APP_THREADPOOL_QUEUE_SIZE as capacity, and the overflowed tasks
+    * are saved in a list, that is no limit. else it's rounded up to power of 2.
+    *@note Take effect at next start().
     */
     void setMaxHoldTasks(u32 it) {
         mMaxTasks = it;
     }
 
+    /**
+    *@brief Set the weight of a priority in weighted round-robin, it's the
+    * share of pops which try this priority first, other priorities are tried
+    * in order of priority if it's empty. So lower priorities are not starved by a flood
+    * of higher priority tasks. default weights: high=16, normal=4, low=1.
+    *@param iPriority The priority.
+    *@param weight 0 means never tried first, set weights of normal and low to 0 for strict priority.
+    * Sum of weights is limited to ESCHEDULE_SIZE, weights are scaled down if it's bigger.
+    *@note Take effect at next start().
+    */
+    void setPriorityWeight(ETaskPriority iPriority, u32 weight) {
+        if(iPriority < ETP_COUNT) {
+            mWeight[iPriority] = weight;
+        }
+    }
+
+    /**
+    *@brief Let the count of workers float in [minThreads, getMaxThreads()].
+    * A worker is spawned if tasks are kept waiting longer than spawnLatency while
+    * no worker is idle, at most one spawn per spawnLatency. A worker above minThreads
+    * retires after being idle for idleTimeout. Keep idleTimeout much bigger than
+    * spawnLatency, so the pool does not thrash.
+    *@param minThreads Min count of workers, at least 1, not elastic if it's not less than max threads.
+    *@param spawnLatency In milliseconds.
+    *@param idleTimeout In milliseconds.
+    *@note Take effect at next start().
+    */
+    void setElastic(u32 minThreads, u32 spawnLatency = 10, u32 idleTimeout = 30000) {
+        mMinThreads = minThreads > 0 ? minThreads : 1;
+        mSpawnLatency = spawnLatency > 0 ? spawnLatency : 1;
+        mIdleTimeout = idleTimeout > 0 ? idleTimeout : 1;
+    }
+
+    /**
+    *@brief Split each global queue into lanes. A task is pushed to the less loaded of two
+    * random lanes, and a worker pops its home lane first, then the other lanes, so producers
+    * and consumers contend on different queues.
+    *@param it Lanes of each queue, 0 means one lane per worker. default: 1
+    *@note Take effect at next start(). The capacity set by setMaxHoldTasks() is per lane.
+    */
+    void setQueueLanes(u32 it) {
+        mLanes = it;
+    }
+
+    /**
+    *@brief Set the placement of workers, the local deques and queues of a NUMA shard
+    * are allocated by threads bound to the node, so they are node local.
+    *@note Take effect at next start().
+    */
+    void setPlacement(EThreadPlacement it) {
+        mPlacement = it;
+    }
+
+    EThreadPlacement getPlacement()const {
+        return mPlacement;
+    }
+
+    /**
+    *@brief Set how an idle worker waits for tasks: spin with CPU pause for spinCount
+    * rounds, then yield CPU for yieldCount rounds, then park until woken.
+    * Only parked workers cost producers a wake syscall. default: 128 spins, 2 yields.
+    *@note Spinning is skipped on single processor system.
+    */
+    void setIdlePolicy(u32 spinCount, u32 yieldCount) {
+        mSpinCount = spinCount;
+        mYieldCount = yieldCount;
+    }
+
+    /**
+    *@brief Enable timing: busy, idle and park time, histograms of wait and run time.
+    * It costs 2 clock reads per task and 1 per post, counters are always on.
+    */
+    void setStatistics(bool it) {
+        mStatistics = it;
+    }
+
+    bool isStatistics()const {
+        return mStatistics;
+    }
+
+    /**
+    *@brief Collect statistics of all workers, cheap enough to poll every second.
+    * Each worker writes its own cache-line padded counters, collecting takes mMutex
+    * only, so it's safe during stop() and join().
+    *@param total Sum of all workers, and of the workers freed by stop() or join().
+    *@param perWorker If not null, statistics of each worker slot are appended,
+    * none if pool is stopped.
+    *@note Counters are read while being written, so they're approximate.
+    * All counters are reset by start().
+    */
+    void getStats(SThreadPoolStats& total, core::array<SThreadPoolStats>* perWorker = 0)const;
+
     void start();
 
+    /**
+    *@brief Stop the pool, waiting tasks and pending timers are dropped.
+    * A dropped IRunnable gets IRunnable::cancel() instead of run(), a dropped functor
+    * is destroyed, so futures, strands and parallel jobs of the pool are completed.
+    *@note The dropped tasks are cancelled by the calling thread after all workers exited.
+    */
     void stop();
 
+    /**
+    *@brief Stop the pool after all waiting tasks finished, pending timers are
+    * dropped as stop() does.
+    */
     void join();
 
-    bool addTask(AppCallable iFunc, void* iData = 0);
+    bool addTask(AppCallable iFunc, void* iData = 0, ETaskPriority iPriority = ETP_NORMAL);
+
+    bool addTask(IRunnable* it, ETaskPriority iPriority = ETP_NORMAL);
+
+    /**
+    *@brief Post a functor task, eg: addTask([=]() { ... }).
+    *@return false if rejected, the task is kept in it.
+    */
+    bool addTask(CTask&& it, ETaskPriority iPriority = ETP_NORMAL);
 
-    bool addTask(IRunnable* it);
+    /**
+    *@brief Post a batch of tasks, and wake at most min(count, idle workers) threads.
+    *@param tasks The tasks to post, copied by bytes, so they must not own functors.
+    *@param count Count of tasks.
+    *@param iPriority Priority of all tasks.
+    *@return Count of posted tasks, the tasks at tail are rejected if queue is full.
+    */
+    u32 addTasks(const SThreadTask* tasks, u32 count, ETaskPriority iPriority = ETP_NORMAL);
 
     /**
     * @bire A threadpool only have one Sole-Task.
+    * @see CSoleTask for any count of lock free coalescing tasks.
     */
     bool addSoleTask(IRunnable* it);
     bool addSoleTask(AppCallable iFunc, void* iData = 0);
 
+    /**
+    *@brief Pop a waiting task and run it in current thread,
+    * used to help the pool instead of blocking when waiting for tasks.
+    *@return false if no task was run.
+    */
+    bool runOneTask();
+
     u32 getMaxThreads()const {
         return mThreadCount;
     }
 
-    u32 getWaitingTasks()const {
-        return mWaitingTasks;
+    u32 getMinThreads()const {
+        return mMinThreads < mThreadCount ? mMinThreads : mThreadCount;
+    }
+
+    /**
+    *@return Count of workers alive now.
+    */
+    u32 getActiveThreads()const {
+        return mWorkerCount;
+    }
+
+    EThreadPoolMode getMode()const {
+        return mMode;
     }
-    
+
+    /**
+    *@return Tasks waiting in global queues and all local deques.
+    */
+    u32 getWaitingTasks()const;
+
+    /**
+    *@return Tasks of a priority waiting in queues, sole task is not counted.
+    */
+    u32 getWaitingTasks(ETaskPriority iPriority)const;
+
+    /**
+    *@brief Post a task to pool after a delay. Timers are kept in a timing wheel
+    * of pool, a timer thread is started by the first timer, and posts ready timers
+    * to the normal queues. Pending timers are dropped by stop() and join().
+    * A fired task rejected by pool, eg: queues are full, is discarded.
+    *@param delay In milliseconds, at most 2^30.
+    *@return Id of the timer, 0 if pool is not running.
+    */
+    u64 addDelayedTask(AppCallable iFunc, void* iData, u32 delay, ETaskPriority iPriority = ETP_NORMAL);
+    u64 addDelayedTask(IRunnable* it, u32 delay, ETaskPriority iPriority = ETP_NORMAL);
+
+    /**
+    *@brief Post a task to pool every period, the first is posted after a period.
+    * It is kept on schedule, so a slow task may run concurrently with its next period.
+    * A fire rejected by pool is skipped, the task is posted again at next period.
+    *@param period In milliseconds, 1 to 2^30.
+    *@return Id of the timer, 0 if pool is not running.
+    */
+    u64 addPeriodicTask(AppCallable iFunc, void* iData, u32 period, ETaskPriority iPriority = ETP_NORMAL);
+    u64 addPeriodicTask(IRunnable* it, u32 period, ETaskPriority iPriority = ETP_NORMAL);
+
+    /**
+    *@brief Cancel a pending timer.
+    *@return false if the timer was fired or cancelled, periodic timers are pending until cancelled.
+    *@note A fired task may be still waiting in queues or running.
+    */
+    bool cancelTimer(u64 id);
+
+    /**
+    *@return Approximate count of pending timers.
+    */
+    u32 getWaitingTimers()const {
+        return mTimers.size();
+    }
+
 private:
     enum {
         ESTATUS_STOPED = 1,
@@ -64,16 +346,74 @@ private:
         ESTATUS_JOINING = 1 << 2
     };
 
+    enum {
+        ESCHEDULE_SIZE = 64
+    };
+
+    struct SWorker;
+
+    ///a task linked in an overflow list
+    struct STaskNode {
+        SThreadTask mTask;
+        STaskNode* mNext;
+
+        STaskNode() : mNext(0) {
+        }
+
+        STaskNode(const SThreadTask& it) : mTask(it), mNext(0) {
+        }
+
+        STaskNode(SThreadTask&& it) : mTask(std::move(it)), mNext(0) {
+        }
+    };
+
     volatile u16 mActiveCount;
     volatile u16 mStatus;
-    volatile u32 mWaitingTasks;
-    u32 mThreadCount;
-    u32 mMaxTasks;          ///<0: disable limit, else limit the max tasks saved in list. default: 0
+    volatile u32 mWaitingTasks;  ///<sole task and all overflowed tasks, guarded by mMutex
+    s32 mIdleCount;         ///<workers parked in mIdleStack
+    u32 mSpinCount;
+    bool mStatistics;
+    u32 mYieldCount;
+    u32 mThreadCount;       ///<max workers
+    u32 mMinThreads;
+    volatile u32 mWorkerCount;  ///<spawned and not retired workers, guarded by mMutex
+    u32 mSpawnLatency;
+    u32 mIdleTimeout;
+    s32 mBacklogSince;      ///<tick when tasks start waiting with no idle worker, 0 if no backlog
+    s32 mLastSpawn;         ///<tick of last elastic spawn, guarded by mMutex
+    u32 mMaxTasks;          ///<capacity of each queue, 0: default capacity and no limit. default: 0
+    EThreadPoolMode mMode;
+    EThreadPlacement mPlacement;
+    u32 mShardCount;        ///<NUMA nodes used in ETPL_NUMA, else 1
+    u32 mLanes;             ///<lanes set by user
+    u32 mLaneCount;         ///<lanes of each queue in use
+    core::array<u32> mCpuShard; ///<processor index to shard
     CMutex mMutex;          ///<note: mutex type PTHREAD_MUTEX_TIMED_NP,PTHREAD_MUTEX_ADAPTIVE_NP
-    CCondition mCondition;
-    SThreadTask mTaskListHead;
-    SThreadTask* mTaskListTail;
+    CLatch mStartLatch;     ///<opened when the first workers of start() are running
+    CSpinlock mIdleLock;    ///<guard mIdleStack
+    u32* mIdleStack;        ///<parked workers, the last parked is woken first
+    u32 mIdleTop;
+    CTaskRing* mQueue;      ///<global queues, ETP_COUNT queues per lane, mLaneCount lanes per shard
+    SThreadTask mSoleTask;
+    u32 mSoleCount;         ///<runs of sole task waiting, guarded by mMutex
+    STaskNode mOverflowHead[ETP_COUNT];     ///<heads of overflow lists, guarded by mMutex
+    STaskNode* mOverflowTail[ETP_COUNT];
+    u32 mOverflowCount[ETP_COUNT];
+    u32 mWeight[ETP_COUNT];
+    u32 mScheduleSize;
+    u8 mSchedule[ESCHEDULE_SIZE];   ///<the priority tried first by each pop, in turn
     CThread** mWorker;
+    SWorker* mWorkerQueue;  ///<set and freed with mMutex, read by getStats() with mMutex
+    SThreadPoolStats mStoppedStats; ///<stats of workers freed by stop() or join(), guarded by mMutex
+    CMutex mTimerMutex;     ///<guard mTimers
+    CTimerWheel mTimers;
+    CThreadEvent mTimerEvent;   ///<wake the timer thread
+    CThread* mTimerThread;
+    s64 mTimerBase;         ///<tick count of tick 0 of mTimers
+    u32 mTimerWake;         ///<tick when the timer thread wakes, guarded by mTimerMutex
+
+    ///the worker running on current thread, 0 if current thread is not a worker.
+    static thread_local SWorker* mCurrentWorker;
 
 
     CThreadPool() { }
@@ -82,10 +422,199 @@ private:
 
     void creatThread(u32 iCount);
 
+    /**
+    *@brief Assign processors and shard to each worker slot by mPlacement.
+    */
+    void placeWorkers();
+
+    /**
+    *@brief Allocate global queues of all shards and lanes.
+    */
+    void createQueues();
+
+    CTaskRing& getQueue(u32 shard, u32 lane, u32 iPriority)const {
+        return mQueue[(shard * mLaneCount + lane) * ETP_COUNT + iPriority];
+    }
+
+    u32 getQueueCount()const {
+        return mShardCount * mLaneCount * ETP_COUNT;
+    }
+
+    /**
+    *@brief Pick the less loaded of two random lanes of a shard.
+    */
+    u32 pickLane(SWorker* current, u32 shard, u32 iPriority)const;
+
+    /**
+    *@brief Push tasks to global queues of the shard, the picked lane first.
+    *@return Count of pushed tasks.
+    */
+    u32 pushQueue(SWorker* current, const SThreadTask* tasks, u32 count, u32 iPriority);
+
+    /**
+    *@brief Push a task to global queues of the shard, it's moved only if pushed.
+    */
+    bool pushQueue(SWorker* current, SThreadTask&& it, u32 iPriority);
+
+    /**
+    *@return Shard of the worker, or shard of current processor if worker is 0.
+    */
+    u32 getShard(const SWorker* worker)const;
+
+    bool isElastic()const {
+        return mMinThreads < mThreadCount;
+    }
+
+    /**
+    *@brief Start a worker in a free slot, the mutex must had been locked first.
+    *@return false if all slots are used.
+    */
+    bool spawnWorker();
+
+    /**
+    *@brief Spawn a worker if tasks waited too long, called when no idle worker.
+    */
+    void checkSpawn();
+
     void removeAll();
+
+    /**
+    *@brief Post a task, it's stamped with post time if statistics is enabled.
+    *@note The task is moved only if posted, so a rejected task is left to caller.
+    */
+    bool postTask(SThreadTask&& it, ETaskPriority iPriority);
+
+    /**
+    *@brief Build mSchedule by smooth weighted round-robin.
+    */
+    void buildSchedule();
+
+    SWorker* getCurrentWorker()const;
+
+    bool popTask(SWorker* worker, SThreadTask& iTask);
+
+    /**
+    *@brief Pop from queues of a priority.
+    *@param worker Current worker, or 0 if current thread is not a worker.
+    */
+    bool popTask(SWorker* worker, u32 iPriority, SThreadTask& iTask);
+
+    /**
+    *@brief Pop overflowed task in order of priority, or sole task, the mutex must had been locked first.
+    *@param iTask The popped task.
+    *@return false if no such tasks.
+    */
+    bool popOverflow(SThreadTask& iTask);
+
+    bool stealTask(SWorker& worker, SThreadTask& iTask);
+
+    bool hasTask()const;
+
+    /**
+    *@brief Spin and yield to wait for a task before parking.
+    *@return false if no task got.
+    */
+    bool spinTask(SWorker* worker, SThreadTask& iTask);
+
+    /**
+    *@brief Wait until tasks posted.
+    *@return false if pool is not running and no more tasks, or the worker retired, worker should exit.
+    */
+    bool waitTask(SWorker& worker);
+
+    /**
+    *@brief Wake parked workers one by one, or spawn a worker if none is parked in elastic mode.
+    *@param count Max workers to wake.
+    */
+    void wakeIdle(u32 count = 1);
+
+    u64 addTimer(const SThreadTask& it, u32 delay, u32 period, ETaskPriority iPriority);
+
+    u32 getTimerTick()const {
+        return (u32) (CThread::getTickCount() - mTimerBase);
+    }
+
+    ///loop of the timer thread
+    static void runTimer(void* it);
+
+    void stopTimer();
+
+    /**
+    *@brief Update max depth of worker by waiting tasks of pool.
+    */
+    void sampleDepth(SWorker& worker);
+};
+
+
+/**
+*@class CTaskBatch
+*@brief A scoped submission batch, tasks are buffered and posted
+* to the pool by CThreadPool::addTasks() when buffer is full or the batch is destroyed.
+*/
+class CTaskBatch {
+public:
+    enum {
+        EBATCH_SIZE = 64
+    };
+
+    CTaskBatch(CThreadPool& pool, ETaskPriority iPriority = ETP_NORMAL) :
+        mPool(pool),
+        mPriority(iPriority),
+        mCount(0),
+        mRejected(0) {
+    }
+
+    ~CTaskBatch() {
+        flush();
+    }
+
+    void add(AppCallable iFunc, void* iData = 0) {
+        if(iFunc) {
+            mTasks[mCount++] = SThreadTask(iFunc, iData);
+            if(EBATCH_SIZE == mCount) {
+                flush();
+            }
+        }
+    }
+
+    void add(IRunnable* it) {
+        if(it) {
+            mTasks[mCount++] = SThreadTask(it);
+            if(EBATCH_SIZE == mCount) {
+                flush();
+            }
+        }
+    }
+
+    /**
+    *@brief Post all buffered tasks.
+    */
+    void flush() {
+        if(mCount > 0) {
+            mRejected += mCount - mPool.addTasks(mTasks, mCount, mPriority);
+            mCount = 0;
+        }
+    }
+
+    /**
+    *@return Count of tasks rejected by pool since this batch created.
+    */
+    u32 getRejected()const {
+        return mRejected;
+    }
+
+private:
+    CTaskBatch(const CTaskBatch& it) = delete;
+    CTaskBatch& operator=(const CTaskBatch& it) = delete;
+
+    CThreadPool& mPool;
+    ETaskPriority mPriority;
+    u32 mCount;
+    u32 mRejected;
+    SThreadTask mTasks[EBATCH_SIZE];
 };
 
 }//irr
 
 
-#endif	/* APP_CTHREADPOOL_H */
\ No newline at end of file
+#endif	/* APP_CTHREADPOOL_H */
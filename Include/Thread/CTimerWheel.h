@@ -0,0 +1,145 @@
+/**
+*@file CTimerWheel.h
+*@brief This file defined a hierarchical timing wheel of thread tasks.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#ifndef APP_CTIMERWHEEL_H
+#define APP_CTIMERWHEEL_H
+
+#include "CThread.h"
+#include "irrArray.h"
+
+namespace irr {
+
+/**
+*@class CTimerWheel
+*@brief A hierarchical timing wheel with 1 tick resolution,
+* the 1st wheel has 256 slots, the other 4 wheels have 64 slots each,
+* so a timer can be delayed for 2^31 ticks at most.
+* Add and cancel are O(1), a timer is cascaded 4 times at most before fired.
+* Timers are kept in blocks of nodes, a timer id is the node index with a
+* serial, so the id of a fired or cancelled timer is invalid.
+*@note Not thread safe, the owner should lock it.
+*/
+class CTimerWheel {
+public:
+    ///a fired timer
+    struct STimerTask {
+        SThreadTask mTask;
+        u32 mPriority;
+        u32 mPeriod;    ///<0 if fired once, else the task is still owned by the timer
+    };
+
+    CTimerWheel();
+
+    ~CTimerWheel();
+
+    /**
+    *@brief Remove all timers and reset current tick, tasks of pending timers are discarded.
+    */
+    void clear(u32 tick = 0);
+
+    /**
+    *@brief Add a timer.
+    *@param task The task to fire.
+    *@param expire Tick when to fire, an expired tick is fired at next update().
+    *@param period Ticks between fires of a periodic timer, 0 if fire once.
+    *@param iPriority Passed back with fired task.
+    *@return Id of the timer, never 0.
+    */
+    u64 add(const SThreadTask& task, u32 expire, u32 period = 0, u32 iPriority = 0);
+
+    /**
+    *@brief Remove a timer.
+    *@return false if the id is not a pending timer.
+    */
+    bool cancel(u64 id);
+
+    /**
+    *@brief Fire all timers expired at tick now, periodic timers are added again.
+    *@param now Current tick, it can't be older than last update.
+    *@param fired Fired tasks are appended here.
+    *@return Count of fired tasks.
+    */
+    u32 update(u32 now, core::array<STimerTask>& fired);
+
+    /**
+    *@brief Ticks from current tick to the next update() which may fire timers.
+    *@return 0xFFFFFFFF if no timer.
+    */
+    u32 getIdleTicks()const;
+
+    u32 getTick()const {
+        return mTick;
+    }
+
+    /**
+    *@return Count of pending timers.
+    */
+    u32 size()const {
+        return mCount;
+    }
+
+private:
+    CTimerWheel(const CTimerWheel& it) = delete;
+    CTimerWheel& operator=(const CTimerWheel& it) = delete;
+
+    enum {
+        EROOT_BITS = 8,
+        EROOT_SIZE = 1 << EROOT_BITS,
+        EROOT_MASK = EROOT_SIZE - 1,
+        ELEVEL_BITS = 6,
+        ELEVEL_SIZE = 1 << ELEVEL_BITS,
+        ELEVEL_MASK = ELEVEL_SIZE - 1,
+        ELEVEL_COUNT = 4,
+        ESLOT_COUNT = EROOT_SIZE + ELEVEL_COUNT * ELEVEL_SIZE,
+        EBLOCK_BITS = 10,
+        EBLOCK_SIZE = 1 << EBLOCK_BITS
+    };
+
+    struct SLink {
+        SLink* mPrev;
+        SLink* mNext;
+    };
+
+    struct STimerNode : public SLink {
+        SThreadTask mTask;
+        u32 mExpire;
+        u32 mPeriod;
+        u32 mPriority;
+        u32 mIndex;     ///<index in blocks
+        u32 mSlot;      ///<linked slot
+        u32 mSerial;    ///<increased when freed, 0 is never used
+    };
+
+    u32 mTick;          ///<the next tick to process
+    u32 mCount;
+    u32 mRootCount;     ///<timers in the 1st wheel
+    SLink mSlot[ESLOT_COUNT];
+    core::array<STimerNode*> mBlocks;
+    STimerNode* mFree;
+
+    STimerNode* getNode(u32 index)const {
+        return mBlocks[index >> EBLOCK_BITS] + (index & (EBLOCK_SIZE - 1));
+    }
+
+    STimerNode* allocNode();
+
+    void freeNode(STimerNode* it);
+
+    void link(STimerNode* it);
+
+    void unlink(STimerNode* it);
+
+    /**
+    *@brief Move timers of a slot in an upper wheel to lower wheels.
+    *@return Index of the slot.
+    */
+    u32 cascade(u32 level);
+};
+
+}//irr
+
+#endif	/* APP_CTIMERWHEEL_H */
@@ -11,6 +11,10 @@
 #include "HConfig.h"
 #include "irrTypes.h"
 
+#if defined(APP_PLATFORM_WINDOWS)
+#include <intrin.h>
+#endif
+
 
 namespace irr {
 void AppAtomicReadBarrier();
@@ -19,6 +23,11 @@ void AppAtomicWriteBarrier();
 
 void AppAtomicReadWriteBarrier();
 
+/**
+*@brief Tell CPU current thread is in a spin-wait loop, eg: the pause instruction of x86.
+*/
+void AppCpuRelax();
+
 /**
 *@brief s32 iTarget |= value;
 */
@@ -100,10 +109,64 @@ void* AppAtomicFetchSet(void* value, void** iTarget);
 *@return The prior value of the iTarget parameter.
 */
 s32 AppAtomicFetchCompareSet(s32 newValue, s32 comparand, s32* iTarget);
+void* AppAtomicFetchCompareSet(void* newValue, void* comparand, void** iTarget);
 
 
 
 s32 AppAtomicFetch(s32* iTarget);
+void* AppAtomicFetch(void** iTarget);
+
+
+/**
+*@brief Relaxed atomic load, no ordering, but a value is never torn, even a 64-bit one
+* on 32-bit platforms, eg: counters written by a thread and read by others.
+*@note A 64-bit value must be aligned on a 64-bit boundary.
+*/
+template<class T>
+inline T AppAtomicLoadRelaxed(const T* iTarget) {
+#if defined(APP_PLATFORM_WINDOWS)
+#if !defined(_WIN64)
+    if(8 == sizeof(T)) {
+        __int64 ret = _InterlockedCompareExchange64((__int64 volatile*) iTarget, 0, 0);
+        return *(T*) &ret;
+    }
+#endif
+    return *(const volatile T*) iTarget;
+#else
+    return __atomic_load_n(iTarget, __ATOMIC_RELAXED);
+#endif
+}
+
+
+///Relaxed atomic store, see AppAtomicLoadRelaxed().
+template<class T>
+inline void AppAtomicStoreRelaxed(T value, T* iTarget) {
+#if defined(APP_PLATFORM_WINDOWS)
+#if !defined(_WIN64)
+    if(8 == sizeof(T)) {
+        __int64 old = *(__int64 volatile*) iTarget;
+        __int64 now;
+        while(old != (now = _InterlockedCompareExchange64((__int64 volatile*) iTarget, *(__int64*) &value, old))) {
+            old = now;
+        }
+        return;
+    }
+#endif
+    *(volatile T*) iTarget = value;
+#else
+    __atomic_store_n(iTarget, value, __ATOMIC_RELAXED);
+#endif
+}
+
+
+/**
+*@brief Add to a counter which is written by current thread only, and read by
+* others with AppAtomicLoadRelaxed(), it's not a read-modify-write atomic.
+*/
+template<class T>
+inline void AppCounterAdd(T* iTarget, T value) {
+    AppAtomicStoreRelaxed((T) (*iTarget + value), iTarget);
+}
 
 } //end namespace irr
 
@@ -27,6 +27,14 @@ public:
     *@brief This function run in thread.
     */
     virtual void run() = 0;
+
+    /**
+    *@brief Called instead of run() when a thread pool drops the task, eg: the pool
+    * is stopped with tasks waiting. Tasks which must complete, eg: release a waiter,
+    * should override it.
+    */
+    virtual void cancel() {
+    }
 };
 
 
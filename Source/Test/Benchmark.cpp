@@ -0,0 +1,441 @@
+/**
+*@file Benchmark.cpp
+*@brief Non-interactive benchmarks of thread pool, results are printed as CSV or JSON.
+*
+* Usage: Benchmark [-t max_threads] [-n tasks] [-json]
+*   -t  Max workers, benchmarks run with 1, 2, 4 ... max_threads workers. default: processor count
+*   -n  Tasks of each throughput benchmark. default: 200000
+*   -json  Print results as JSON, default is CSV.
+*@author antmuse@live.cn
+*@date 2014-09-22
+*/
+
+#include "CThread.h"
+#include "CThreadPool.h"
+#include "CLatch.h"
+#include "CSpinlock.h"
+#include "CMutex.h"
+#include "CFastMutex.h"
+#include "CReadMostlyLock.h"
+#include "CHistogram.h"
+#include "HAtomicOperator.h"
+#include "IAppLogger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#if defined(APP_PLATFORM_WINDOWS)
+#if defined(APP_OS_64BIT)
+#if defined(APP_DEBUG)
+#pragma comment (lib, "Thread-64D.lib")
+#else
+#pragma comment (lib, "Thread-64.lib")
+#endif //APP_DEBUG
+#else
+#if defined(APP_DEBUG)
+#pragma comment (lib, "Thread-32D.lib")
+#else
+#pragma comment (lib, "Thread-32.lib")
+#endif //APP_DEBUG
+#endif //APP_OS_64BIT
+#endif  //APP_PLATFORM_WINDOWS
+
+
+
+namespace irr {
+
+///a configuration of pool to compare
+struct SBenchMode {
+    const c8* mName;
+    EThreadPoolMode mMode;
+    u32 mLanes;         ///<see CThreadPool::setQueueLanes()
+    bool mPark;         ///<park idle workers at once, no spinning
+};
+
+static const SBenchMode G_BENCH_MODES[] = {
+    {"shared", ETPM_SHARED_QUEUE, 1, false},
+    {"lanes", ETPM_SHARED_QUEUE, 0, false},
+    {"stealing", ETPM_WORK_STEALING, 1, false},
+    {"park", ETPM_SHARED_QUEUE, 1, true}
+};
+
+static const u32 G_BENCH_MODE_COUNT = sizeof(G_BENCH_MODES) / sizeof(G_BENCH_MODES[0]);
+
+
+///a row of results
+struct SBenchResult {
+    const c8* mBench;
+    const c8* mMode;
+    u32 mThreads;
+    u32 mProducers;
+    u64 mOps;
+    s64 mTime;          ///<nanoseconds
+    u64 mP50;           ///<latency percentiles in nanoseconds, 0 if not measured
+    u64 mP99;
+    u64 mP999;
+    u64 mMax;
+
+    f64 getOpsPerSecond()const {
+        return mTime > 0 ? (f64) mOps * 1000000000.0 / (f64) mTime : 0.0;
+    }
+
+    f64 getNanosecondsPerOp()const {
+        return mOps > 0 ? (f64) mTime / (f64) mOps : 0.0;
+    }
+};
+
+
+///shared by tasks of a benchmark
+struct SBenchContext {
+    CThreadPool* mPool;
+    CLatch mDone;
+    s32 mLeft;
+    u32 mFanOut;
+    u32 mCount;         ///<tasks to post by each producer
+};
+
+
+static core::array<SBenchResult> G_BENCH_RESULTS;
+
+
+static void AppBenchAddResult(const c8* bench, const c8* mode, u32 threads, u32 producers,
+    u64 ops, s64 time, const CHistogram* latency = 0) {
+    SBenchResult it;
+    it.mBench = bench;
+    it.mMode = mode;
+    it.mThreads = threads;
+    it.mProducers = producers;
+    it.mOps = ops;
+    it.mTime = time;
+    it.mP50 = latency ? latency->getPercentile(50.0) : 0;
+    it.mP99 = latency ? latency->getPercentile(99.0) : 0;
+    it.mP999 = latency ? latency->getPercentile(99.9) : 0;
+    it.mMax = latency ? latency->getMax() : 0;
+    G_BENCH_RESULTS.push_back(it);
+    fprintf(stderr, "%-10s %-9s threads=%-3u producers=%-3u %12.0f ops/s %10.1f ns/op\n",
+        bench, mode, threads, producers, it.getOpsPerSecond(), it.getNanosecondsPerOp());
+}
+
+
+static void AppBenchStartPool(CThreadPool& pool, const SBenchMode& mode) {
+    pool.setQueueLanes(mode.mLanes);
+    if(mode.mPark) {
+        pool.setIdlePolicy(0, 0);
+    }
+    pool.start();
+}
+
+
+///post a task, help the pool if it's rejected by a full queue
+static void AppBenchPost(CThreadPool& pool, AppCallable iFunc, void* iData) {
+    while(!pool.addTask(iFunc, iData)) {
+        if(!pool.runOneTask()) {
+            CThread::yield();
+        }
+    }
+}
+
+
+static void AppBenchEmpty(void* it) {
+    ((SBenchContext*) it)->mDone.countDown();
+}
+
+
+/**
+*@brief Throughput of empty tasks posted by current thread.
+*/
+static void AppBenchThroughput(const SBenchMode& mode, u32 threads, u32 tasks) {
+    CThreadPool pool(threads, mode.mMode);
+    AppBenchStartPool(pool, mode);
+    SBenchContext ctx;
+    ctx.mDone.reset(tasks);
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < tasks; ++i) {
+        AppBenchPost(pool, AppBenchEmpty, &ctx);
+    }
+    ctx.mDone.wait();
+    s64 time = CThread::getTickNanoseconds() - start;
+    pool.join();
+    AppBenchAddResult("empty", mode.mName, threads, 1, tasks, time);
+}
+
+
+/**
+*@brief Submit to start latency, measured by statistics of pool.
+* Tasks are posted in small bursts so the queues don't grow.
+*/
+static void AppBenchLatency(const SBenchMode& mode, u32 threads, u32 tasks) {
+    CThreadPool pool(threads, mode.mMode);
+    pool.setStatistics(true);
+    AppBenchStartPool(pool, mode);
+    SBenchContext ctx;
+    u32 rounds = tasks / threads;
+    rounds = rounds > 10000 ? 10000 : rounds;
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < rounds; ++i) {
+        ctx.mDone.reset(threads);
+        for(u32 j = 0; j < threads; ++j) {
+            AppBenchPost(pool, AppBenchEmpty, &ctx);
+        }
+        ctx.mDone.wait();
+    }
+    s64 time = CThread::getTickNanoseconds() - start;
+    //wait time is recorded before a task runs, all are recorded now.
+    SThreadPoolStats stats;
+    pool.getStats(stats);
+    pool.join();
+    AppBenchAddResult("latency", mode.mName, threads, 1, (u64) rounds * threads, time, &stats.mWaitTime);
+}
+
+
+static void AppBenchLeaf(void* it) {
+    SBenchContext& ctx = *(SBenchContext*) it;
+    if(0 == AppAtomicDecrementFetch(&ctx.mLeft)) {
+        ctx.mDone.countDown();
+    }
+}
+
+
+static void AppBenchRoot(void* it) {
+    SBenchContext& ctx = *(SBenchContext*) it;
+    for(u32 i = 0; i < ctx.mFanOut; ++i) {
+        AppBenchPost(*ctx.mPool, AppBenchLeaf, it);
+    }
+}
+
+
+/**
+*@brief A worker posts a batch of tasks, the last finished one wakes the waiter.
+* Reports rounds of fan-out and fan-in.
+*/
+static void AppBenchFanOut(const SBenchMode& mode, u32 threads, u32 tasks) {
+    CThreadPool pool(threads, mode.mMode);
+    AppBenchStartPool(pool, mode);
+    SBenchContext ctx;
+    ctx.mPool = &pool;
+    ctx.mFanOut = 8 * threads;
+    u32 rounds = tasks / ctx.mFanOut;
+    rounds = rounds > 0 ? rounds : 1;
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < rounds; ++i) {
+        ctx.mLeft = (s32) ctx.mFanOut;
+        ctx.mDone.reset(1);
+        AppBenchPost(pool, AppBenchRoot, &ctx);
+        ctx.mDone.wait();
+    }
+    s64 time = CThread::getTickNanoseconds() - start;
+    pool.join();
+    AppBenchAddResult("fanout", mode.mName, threads, 1, rounds, time);
+}
+
+
+static void AppBenchProduce(void* it) {
+    SBenchContext& ctx = *(SBenchContext*) it;
+    for(u32 i = 0; i < ctx.mCount; ++i) {
+        AppBenchPost(*ctx.mPool, AppBenchEmpty, it);
+    }
+}
+
+
+/**
+*@brief Empty tasks posted by producer threads which are not workers.
+*/
+static void AppBenchProducers(const SBenchMode& mode, u32 threads, u32 producers, u32 tasks) {
+    CThreadPool pool(threads, mode.mMode);
+    AppBenchStartPool(pool, mode);
+    SBenchContext ctx;
+    ctx.mPool = &pool;
+    ctx.mCount = tasks / producers;
+    ctx.mDone.reset(ctx.mCount * producers);
+    CThread* workers = new CThread[producers];
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < producers; ++i) {
+        workers[i].start(AppBenchProduce, &ctx);
+    }
+    for(u32 i = 0; i < producers; ++i) {
+        workers[i].join();
+    }
+    ctx.mDone.wait();
+    s64 time = CThread::getTickNanoseconds() - start;
+    pool.join();
+    delete[] workers;
+    AppBenchAddResult("prodcons", mode.mName, threads, producers, (u64) ctx.mCount * producers, time);
+}
+
+
+template<class T>
+struct SBenchLockContext {
+    SBenchContext mContext;
+    T mLock;
+    u64 mValue;
+};
+
+
+template<class T>
+static void AppBenchLockLoop(void* it) {
+    SBenchLockContext<T>& ctx = *(SBenchLockContext<T>*) it;
+    for(u32 i = 0; i < ctx.mContext.mCount; ++i) {
+        ctx.mLock.lock();
+        ++ctx.mValue;
+        ctx.mLock.unlock();
+    }
+    ctx.mContext.mDone.countDown();
+}
+
+
+/**
+*@brief Every worker increases a shared counter under the lock, reports acquisitions.
+*/
+template<class T>
+static void AppBenchLock(const c8* name, u32 threads, u32 tasks) {
+    CThreadPool pool(threads);
+    pool.start();
+    SBenchLockContext<T> ctx;
+    ctx.mValue = 0;
+    ctx.mContext.mCount = tasks / threads;
+    ctx.mContext.mDone.reset(threads);
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < threads; ++i) {
+        AppBenchPost(pool, AppBenchLockLoop<T>, &ctx);
+    }
+    ctx.mContext.mDone.wait();
+    s64 time = CThread::getTickNanoseconds() - start;
+    pool.join();
+    APP_ASSERT(ctx.mValue == (u64) ctx.mContext.mCount * threads);
+    AppBenchAddResult("lock", name, threads, threads, ctx.mValue, time);
+}
+
+
+template<class T>
+static void AppBenchReadLoop(void* it) {
+    SBenchLockContext<T>& ctx = *(SBenchLockContext<T>*) it;
+    u64 sum = 0;
+    for(u32 i = 1; i <= ctx.mContext.mCount; ++i) {
+        if(0 == i % 10000) {
+            CAutoLockWrite ak(ctx.mLock);
+            ++ctx.mValue;
+        } else {
+            CAutoLockRead ak(ctx.mLock);
+            sum += ctx.mValue;
+        }
+    }
+    //keep the reads from being optimized out
+    AppAtomicFetchAdd((s32) (sum & 1), &ctx.mContext.mLeft);
+    ctx.mContext.mDone.countDown();
+}
+
+
+/**
+*@brief Every worker reads a shared value under the read lock, and writes it once per 10000 reads.
+*/
+template<class T>
+static void AppBenchReadLock(const c8* name, u32 threads, u32 tasks) {
+    CThreadPool pool(threads);
+    pool.start();
+    SBenchLockContext<T> ctx;
+    ctx.mValue = 0;
+    ctx.mContext.mLeft = 0;
+    ctx.mContext.mCount = tasks / threads;
+    ctx.mContext.mDone.reset(threads);
+    s64 start = CThread::getTickNanoseconds();
+    for(u32 i = 0; i < threads; ++i) {
+        AppBenchPost(pool, AppBenchReadLoop<T>, &ctx);
+    }
+    ctx.mContext.mDone.wait();
+    s64 time = CThread::getTickNanoseconds() - start;
+    pool.join();
+    AppBenchAddResult("readlock", name, threads, threads, (u64) ctx.mContext.mCount * threads, time);
+}
+
+
+static void AppBenchPrintCSV() {
+    printf("bench,mode,threads,producers,ops,time_ns,ops_per_sec,ns_per_op,p50_ns,p99_ns,p999_ns,max_ns\n");
+    for(u32 i = 0; i < G_BENCH_RESULTS.size(); ++i) {
+        const SBenchResult& it = G_BENCH_RESULTS[i];
+        printf("%s,%s,%u,%u,%llu,%lld,%.0f,%.1f,%llu,%llu,%llu,%llu\n",
+            it.mBench, it.mMode, it.mThreads, it.mProducers,
+            (unsigned long long) it.mOps, (long long) it.mTime,
+            it.getOpsPerSecond(), it.getNanosecondsPerOp(),
+            (unsigned long long) it.mP50, (unsigned long long) it.mP99,
+            (unsigned long long) it.mP999, (unsigned long long) it.mMax);
+    }
+}
+
+
+static void AppBenchPrintJSON() {
+    printf("[\n");
+    for(u32 i = 0; i < G_BENCH_RESULTS.size(); ++i) {
+        const SBenchResult& it = G_BENCH_RESULTS[i];
+        printf("  {\"bench\": \"%s\", \"mode\": \"%s\", \"threads\": %u, \"producers\": %u, "
+            "\"ops\": %llu, \"time_ns\": %lld, \"ops_per_sec\": %.0f, \"ns_per_op\": %.1f, "
+            "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}%s\n",
+            it.mBench, it.mMode, it.mThreads, it.mProducers,
+            (unsigned long long) it.mOps, (long long) it.mTime,
+            it.getOpsPerSecond(), it.getNanosecondsPerOp(),
+            (unsigned long long) it.mP50, (unsigned long long) it.mP99,
+            (unsigned long long) it.mP999, (unsigned long long) it.mMax,
+            i + 1 < G_BENCH_RESULTS.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+
+void AppRunBenchmarks(u32 maxThreads, u32 tasks) {
+    for(u32 threads = 1; ; threads = (threads * 2 < maxThreads ? threads * 2 : maxThreads)) {
+        for(u32 i = 0; i < G_BENCH_MODE_COUNT; ++i) {
+            const SBenchMode& mode = G_BENCH_MODES[i];
+            AppBenchThroughput(mode, threads, tasks);
+            AppBenchLatency(mode, threads, tasks);
+            AppBenchFanOut(mode, threads, tasks);
+            //producer:consumer as 1:N, N:N and N:1
+            AppBenchProducers(mode, threads, 1, tasks);
+            if(threads > 1) {
+                AppBenchProducers(mode, threads, threads, tasks);
+                AppBenchProducers(mode, 1, threads, tasks);
+            }
+        }
+        AppBenchLock<CSpinlock>("spinlock", threads, tasks);
+        AppBenchLock<CTicketLock>("ticket", threads, tasks);
+        AppBenchLock<CMCSLock>("mcs", threads, tasks);
+        AppBenchLock<CMutex>("mutex", threads, tasks);
+        AppBenchLock<CFastMutex>("fastmutex", threads, tasks);
+        AppBenchReadLock<CReadWriteLock>("rwlock", threads, tasks);
+        AppBenchReadLock<CReadMostlyLock>("readmostly", threads, tasks);
+        if(threads == maxThreads) {
+            break;
+        }
+    }
+}
+
+}//namespace irr
+
+
+int main(int argc, char** argv) {
+    irr::u32 maxThreads = irr::CThread::getProcessorCount();
+    irr::u32 tasks = 200000;
+    bool json = false;
+    for(int i = 1; i < argc; ++i) {
+        if(0 == strcmp(argv[i], "-t") && i + 1 < argc) {
+            maxThreads = (irr::u32) atoi(argv[++i]);
+        } else if(0 == strcmp(argv[i], "-n") && i + 1 < argc) {
+            tasks = (irr::u32) atoi(argv[++i]);
+        } else if(0 == strcmp(argv[i], "-json")) {
+            json = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-t max_threads] [-n tasks] [-json]\n", argv[0]);
+            return 1;
+        }
+    }
+    maxThreads = maxThreads > 0 ? maxThreads : 1;
+    tasks = tasks > maxThreads ? tasks : maxThreads;
+    //keep stdout for results only
+    irr::IAppLogger::setLevel(irr::ELOG_COUNT);
+    irr::AppRunBenchmarks(maxThreads, tasks);
+    if(json) {
+        irr::AppBenchPrintJSON();
+    } else {
+        irr::AppBenchPrintCSV();
+    }
+    return 0;
+}//main
@@ -0,0 +1,154 @@
+#include "CCoroutine.h"
+
+#if defined(APP_USE_COROUTINE)
+
+namespace irr {
+
+void CCoResume::cancel() {
+    //this is in a frame of root, don't touch it after destroy.
+    if(mRoot) {
+        mRoot.destroy();
+    } else {
+        mHandle.resume();
+    }
+}
+
+
+void CCoWaitList::resume(SCoWaiter* it) {
+    while(it) {
+        //the waiter is in the frame, read it before the coroutine runs.
+        SCoWaiter* next = it->mNext;
+        if(!it->mPool->addTask(&it->mResume)) {
+            it->mResume.run();
+        }
+        it = next;
+    }
+}
+
+
+void CCoEvent::set() {
+    SCoWaiter* ready = 0;
+    mLock.lock();
+    if(mAutoReset) {
+        ready = pop();
+        if(ready) {
+            ready->mNext = 0;
+        } else {
+            mSignaled = true;
+        }
+    } else {
+        mSignaled = true;
+        ready = mHead;
+        mHead = 0;
+        mTail = 0;
+    }
+    mLock.unlock();
+    resume(ready);
+}
+
+
+void CCoEvent::reset() {
+    CAutoSpinlock ak(mLock);
+    mSignaled = false;
+}
+
+
+bool CCoEvent::tryAcquire() {
+    CAutoSpinlock ak(mLock);
+    if(!mSignaled) {
+        return false;
+    }
+    if(mAutoReset) {
+        mSignaled = false;
+    }
+    return true;
+}
+
+
+bool CCoEvent::suspend(SCoWaiter& it) {
+    CAutoSpinlock ak(mLock);
+    if(mSignaled) {
+        if(mAutoReset) {
+            mSignaled = false;
+        }
+        return false;
+    }
+    push(it);
+    return true;
+}
+
+
+void CCoSemaphore::post(u32 count/* = 1*/) {
+    SCoWaiter* ready = 0;
+    SCoWaiter** tail = &ready;
+    mLock.lock();
+    for(; count > 0 && mHead; --count) {
+        *tail = pop();
+        tail = &(*tail)->mNext;
+    }
+    *tail = 0;
+    mCount += count;
+    mLock.unlock();
+    resume(ready);
+}
+
+
+bool CCoSemaphore::tryAcquire() {
+    CAutoSpinlock ak(mLock);
+    if(0 == mCount) {
+        return false;
+    }
+    --mCount;
+    return true;
+}
+
+
+bool CCoSemaphore::suspend(SCoWaiter& it) {
+    CAutoSpinlock ak(mLock);
+    if(mCount > 0) {
+        --mCount;
+        return false;
+    }
+    push(it);
+    return true;
+}
+
+
+void CCoMutex::unlock() {
+    mLock.lock();
+    APP_ASSERT(mLocked);
+    SCoWaiter* next = pop();
+    if(next) {
+        //still locked, owned by next.
+        next->mNext = 0;
+    } else {
+        mLocked = false;
+    }
+    mLock.unlock();
+    resume(next);
+}
+
+
+bool CCoMutex::tryAcquire() {
+    CAutoSpinlock ak(mLock);
+    if(mLocked) {
+        return false;
+    }
+    mLocked = true;
+    return true;
+}
+
+
+bool CCoMutex::suspend(SCoWaiter& it) {
+    CAutoSpinlock ak(mLock);
+    if(!mLocked) {
+        mLocked = true;
+        return false;
+    }
+    push(it);
+    return true;
+}
+
+}//irr
+
+#endif //APP_USE_COROUTINE
@@ -0,0 +1,354 @@
+#include "CEpoch.h"
+#include "CThreadPool.h"
+
+#if defined(APP_PLATFORM_WINDOWS)
+#include <winsock2.h>
+#include <Windows.h>
+#include <intrin.h>
+#elif defined(APP_PLATFORM_ANDROID) || defined(APP_PLATFORM_LINUX)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace irr {
+
+///retired objects of a thread to collect at once
+static const u32 G_EPOCH_BATCH = 64;
+
+///an object is safe to free after the epoch advanced twice, the epoch steps by 2.
+static const s32 G_EPOCH_GRACE = 4;
+
+///commands of linux membarrier()
+static const int G_MEMBARRIER_PRIVATE_EXPEDITED = (1 << 3);
+static const int G_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED = (1 << 4);
+
+
+struct SEpochRetired {
+    void* mPointer;
+    AppCallable mDeleter;
+    s32 mEpoch;
+};
+
+
+///record of a thread, in the list of CEpochGlobal
+struct SEpochRecord {
+    s32 mState;             ///<(epoch | 1) if inside critical section, else 0, written by owner
+    s8 mPadding[APP_CACHE_LINE_SIZE - sizeof(s32)];
+    u32 mNest;
+    u32 mThreshold;         ///<size of mRetired to reclaim at
+    SEpochRecord* mNext;
+    core::array<SEpochRetired> mRetired;
+
+    SEpochRecord() : mState(0), mNest(0), mThreshold(G_EPOCH_BATCH), mNext(0) {
+    }
+};
+
+
+class CEpochGlobal {
+public:
+    CEpochGlobal();
+
+    ~CEpochGlobal();
+
+    s32 mEpoch;             ///<global epoch, even
+    s32 mPending;
+    s32 mOrphanCount;
+    s8 mPadding[APP_CACHE_LINE_SIZE - 3 * sizeof(s32)];
+    bool mAsymmetric;       ///<process wide barrier is supported
+    void* mPool;            ///<CThreadPool
+    CMutex mLock;           ///<guard records and orphans
+    SEpochRecord* mRecords;
+    core::array<SEpochRetired> mOrphans;    ///<left by exited threads
+};
+
+static CEpochGlobal G_EPOCH;
+
+
+///record holder of current thread, it's released at thread exit.
+class CEpochRecordHolder {
+public:
+    CEpochRecordHolder() : mRecord(0) {
+    }
+
+    ~CEpochRecordHolder();
+
+    SEpochRecord* get() {
+        return mRecord ? mRecord : create();
+    }
+
+private:
+    SEpochRecord* create();
+
+    SEpochRecord* mRecord;
+};
+
+static thread_local CEpochRecordHolder G_EPOCH_RECORD;
+
+
+/**
+*@brief Store by the owner of record, ordered against other threads by the process wide
+* barrier of reclaimer, only compiler reordering is prevented here.
+*/
+static inline void AppEpochStore(s32* it, s32 value) {
+#if defined(APP_PLATFORM_WINDOWS)
+    _ReadWriteBarrier();
+    *(volatile s32*) it = value;
+    _ReadWriteBarrier();
+#else
+    __atomic_store_n(it, value, __ATOMIC_RELEASE);
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+
+static bool AppEpochInitBarrier() {
+#if defined(APP_PLATFORM_WINDOWS)
+    return true;
+#elif defined(__NR_membarrier)
+    return 0 == ::syscall(__NR_membarrier, G_MEMBARRIER_REGISTER_PRIVATE_EXPEDITED, 0);
+#else
+    return false;
+#endif
+}
+
+
+///a full barrier on all running threads of this process
+static void AppEpochHeavyBarrier() {
+#if defined(APP_PLATFORM_WINDOWS)
+    ::FlushProcessWriteBuffers();
+#elif defined(__NR_membarrier)
+    ::syscall(__NR_membarrier, G_MEMBARRIER_PRIVATE_EXPEDITED, 0);
+#endif
+}
+
+
+static void AppEpochFree(core::array<SEpochRetired>& batch) {
+    for(u32 i = 0; i < batch.size(); ++i) {
+        batch[i].mDeleter(batch[i].mPointer);
+    }
+    AppAtomicFetchAdd(-(s32) batch.size(), &G_EPOCH.mPending);
+}
+
+
+///a batch posted to pool, it's freed inline if the pool drops it, eg: stopped.
+class CEpochBatch : public IRunnable {
+public:
+    virtual void run()override {
+        AppEpochFree(mRetired);
+        delete this;
+    }
+
+    virtual void cancel()override {
+        run();
+    }
+
+    core::array<SEpochRetired> mRetired;
+};
+
+
+static inline bool AppEpochExpired(const SEpochRetired& it, s32 epoch) {
+    return (s32) ((u32) epoch - (u32) it.mEpoch) >= G_EPOCH_GRACE;
+}
+
+
+/**
+*@brief Move objects passed grace period from list to batch.
+*/
+static void AppEpochCollect(core::array<SEpochRetired>& list, s32 epoch, core::array<SEpochRetired>& batch) {
+    u32 kept = 0;
+    for(u32 i = 0; i < list.size(); ++i) {
+        if(AppEpochExpired(list[i], epoch)) {
+            batch.push_back(list[i]);
+        } else {
+            list[kept++] = list[i];
+        }
+    }
+    list.set_used(kept);
+}
+
+
+/**
+*@brief Objects retired by a thread are in epoch order, move the expired head of list to batch.
+* It stops at the first object in grace period, so a stalled reader doesn't cost a full scan.
+*/
+static void AppEpochCollectHead(core::array<SEpochRetired>& list, s32 epoch, core::array<SEpochRetired>& batch) {
+    u32 count = 0;
+    while(count < list.size() && AppEpochExpired(list[count], epoch)) {
+        batch.push_back(list[count++]);
+    }
+    list.erase(0, (s32) count);
+}
+
+
+/**
+*@brief Advance the epoch if all threads in critical sections have seen it.
+*@return true if advanced.
+*/
+static bool AppEpochAdvance() {
+    CAutoLock ak(G_EPOCH.mLock);
+    if(G_EPOCH.mAsymmetric) {
+        AppEpochHeavyBarrier();
+    }
+    s32 epoch = AppAtomicFetch(&G_EPOCH.mEpoch);
+    for(SEpochRecord* it = G_EPOCH.mRecords; it; it = it->mNext) {
+        s32 state = AppAtomicFetch(&it->mState);
+        if((state & 1) && (state & ~1) != epoch) {
+            return false;
+        }
+    }
+    AppAtomicFetchSet((s32) ((u32) epoch + 2), &G_EPOCH.mEpoch);
+    return true;
+}
+
+
+CEpochGlobal::CEpochGlobal() :
+    mEpoch(0),
+    mPending(0),
+    mOrphanCount(0),
+    mAsymmetric(AppEpochInitBarrier()),
+    mPool(0),
+    mRecords(0) {
+}
+
+
+CEpochGlobal::~CEpochGlobal() {
+    //all threads have exited.
+    for(u32 i = 0; i < mOrphans.size(); ++i) {
+        mOrphans[i].mDeleter(mOrphans[i].mPointer);
+    }
+}
+
+
+SEpochRecord* CEpochRecordHolder::create() {
+    mRecord = new SEpochRecord();
+    CAutoLock ak(G_EPOCH.mLock);
+    mRecord->mNext = G_EPOCH.mRecords;
+    G_EPOCH.mRecords = mRecord;
+    return mRecord;
+}
+
+
+CEpochRecordHolder::~CEpochRecordHolder() {
+    if(!mRecord) {
+        return;
+    }
+    CAutoLock ak(G_EPOCH.mLock);
+    for(SEpochRecord** it = &G_EPOCH.mRecords; *it; it = &(*it)->mNext) {
+        if(*it == mRecord) {
+            *it = mRecord->mNext;
+            break;
+        }
+    }
+    for(u32 i = 0; i < mRecord->mRetired.size(); ++i) {
+        G_EPOCH.mOrphans.push_back(mRecord->mRetired[i]);
+    }
+    AppAtomicFetchSet((s32) G_EPOCH.mOrphans.size(), &G_EPOCH.mOrphanCount);
+    delete mRecord;
+    mRecord = 0;
+}
+
+
+void CEpoch::enter() {
+    SEpochRecord* rec = G_EPOCH_RECORD.get();
+    if(0 == rec->mNest++) {
+        s32 state = AppAtomicFetch(&G_EPOCH.mEpoch) | 1;
+        if(G_EPOCH.mAsymmetric) {
+            AppEpochStore(&rec->mState, state);
+        } else {
+            //the state must be visible before loading shared pointers.
+            AppAtomicFetchSet(state, &rec->mState);
+        }
+    }
+}
+
+
+void CEpoch::leave() {
+    SEpochRecord* rec = G_EPOCH_RECORD.get();
+    APP_ASSERT(rec->mNest > 0);
+    if(0 == --rec->mNest) {
+        AppEpochStore(&rec->mState, 0);
+    }
+}
+
+
+bool CEpoch::isInside() {
+    return G_EPOCH_RECORD.get()->mNest > 0;
+}
+
+
+void CEpoch::retire(void* it, AppCallable deleter) {
+    SEpochRecord* rec = G_EPOCH_RECORD.get();
+    SEpochRetired item;
+    item.mPointer = it;
+    item.mDeleter = deleter;
+    //read after the object was unlinked, new readers can't reach it from this epoch.
+    item.mEpoch = AppAtomicFetch(&G_EPOCH.mEpoch);
+    rec->mRetired.push_back(item);
+    AppAtomicIncrementFetch(&G_EPOCH.mPending);
+    if(rec->mRetired.size() >= rec->mThreshold) {
+        reclaim();
+        //a stalled reader blocks the epoch, retry after another batch, not at every retire.
+        rec->mThreshold = rec->mRetired.size() + G_EPOCH_BATCH;
+    }
+}
+
+
+u32 CEpoch::reclaim() {
+    SEpochRecord* rec = G_EPOCH_RECORD.get();
+    AppEpochAdvance();
+    s32 epoch = AppAtomicFetch(&G_EPOCH.mEpoch);
+    //allocated only if there is something to free.
+    core::array<SEpochRetired> batch;
+    AppEpochCollectHead(rec->mRetired, epoch, batch);
+    if(AppAtomicFetch(&G_EPOCH.mOrphanCount) > 0) {
+        CAutoLock ak(G_EPOCH.mLock);
+        AppEpochCollect(G_EPOCH.mOrphans, epoch, batch);
+        AppAtomicFetchSet((s32) G_EPOCH.mOrphans.size(), &G_EPOCH.mOrphanCount);
+    }
+    u32 ret = batch.size();
+    if(0 == ret) {
+        return 0;
+    }
+    CThreadPool* pool = (CThreadPool*) AppAtomicFetch(&G_EPOCH.mPool);
+    if(pool) {
+        CEpochBatch* task = new CEpochBatch();
+        task->mRetired.swap(batch);
+        if(pool->addTask(task)) {
+            return ret;
+        }
+        batch.swap(task->mRetired);
+        delete task;
+    }
+    AppEpochFree(batch);
+    return ret;
+}
+
+
+void CEpoch::synchronize() {
+    APP_ASSERT(!isInside());
+    const u32 target = (u32) AppAtomicFetch(&G_EPOCH.mEpoch) + G_EPOCH_GRACE;
+    while((s32) ((u32) AppAtomicFetch(&G_EPOCH.mEpoch) - target) < 0) {
+        if(!AppEpochAdvance()) {
+            CThread::yield();
+        }
+    }
+    reclaim();
+}
+
+
+void CEpoch::setPool(CThreadPool* pool) {
+    AppAtomicFetchSet((void*) pool, &G_EPOCH.mPool);
+}
+
+
+u32 CEpoch::getEpoch() {
+    return (u32) AppAtomicFetch(&G_EPOCH.mEpoch) >> 1;
+}
+
+
+u32 CEpoch::getPending() {
+    s32 ret = AppAtomicFetch(&G_EPOCH.mPending);
+    return ret > 0 ? (u32) ret : 0;
+}
+
+}//irr
@@ -0,0 +1,160 @@
+#include "CFastMutex.h"
+#include "HAtomicOperator.h"
+#include "CThread.h"
+
+#if defined(APP_PLATFORM_WINDOWS)
+#include <winsock2.h>
+#include <Windows.h>
+#pragma comment (lib, "Synchronization.lib")
+#elif defined(APP_PLATFORM_ANDROID) || defined(APP_PLATFORM_LINUX)
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+namespace irr {
+
+///max spins of a contended lock()
+static const u32 G_FAST_MUTEX_SPIN_MAX = 512;
+
+
+/**
+*@brief Sleep while (*it == value), may wake spuriously.
+*@param milliseconds Max time to sleep, <0 means no timeout.
+*/
+static void AppFutexWait(s32* it, s32 value, long milliseconds) {
+#if defined(APP_PLATFORM_WINDOWS)
+    ::WaitOnAddress(it, &value, sizeof(value), milliseconds < 0 ? INFINITE : (DWORD) milliseconds);
+#elif defined(APP_PLATFORM_ANDROID) || defined(APP_PLATFORM_LINUX)
+    struct timespec tm;
+    tm.tv_sec = milliseconds / 1000;
+    tm.tv_nsec = (milliseconds % 1000) * 1000000;
+    ::syscall(SYS_futex, it, FUTEX_WAIT_PRIVATE, value, milliseconds < 0 ? 0 : &tm, 0, 0);
+#endif
+}
+
+
+static void AppFutexWakeOne(s32* it) {
+#if defined(APP_PLATFORM_WINDOWS)
+    ::WakeByAddressSingle(it);
+#elif defined(APP_PLATFORM_ANDROID) || defined(APP_PLATFORM_LINUX)
+    ::syscall(SYS_futex, it, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+#endif
+}
+
+
+CFastMutex::CFastMutex() :
+    mValue(0) {
+}
+
+
+CFastMutex::~CFastMutex() {
+}
+
+
+void CFastMutex::lock() {
+    if(tryLock()) {
+        return;
+    }
+    u32 spins = 0;
+    if(!spinLock(spins)) {
+        waitLock(-1);
+    }
+    updateBudget(spins);
+}
+
+
+bool CFastMutex::tryLock() {
+    s32 val = AppAtomicFetch(&mValue);
+    while(0 == (val & ES_LOCKED)) {
+        s32 old = AppAtomicFetchCompareSet(val | ES_LOCKED, val, &mValue);
+        if(old == val) {
+            return true;
+        }
+        val = old;//the budget was changed
+    }
+    return false;
+}
+
+
+bool CFastMutex::tryLock(long milliseconds) {
+    if(tryLock()) {
+        return true;
+    }
+    u32 spins = 0;
+    if(spinLock(spins) || waitLock(milliseconds)) {
+        updateBudget(spins);
+        return true;
+    }
+    return false;
+}
+
+
+void CFastMutex::unlock() {
+    s32 old = AppAtomicFetchAnd(~(s32) ES_MASK, &mValue);
+    if(old & ES_WAITING) {
+        AppFutexWakeOne(&mValue);
+    }
+}
+
+
+u32 CFastMutex::getSpinBudget()const {
+    return (u32) AppAtomicFetch((s32*) &mValue) >> ES_BUDGET_SHIFT;
+}
+
+
+bool CFastMutex::spinLock(u32& spins) {
+    //spinning can't help on single processor, the holder is not running.
+    static const u32 cpus = CThread::getProcessorCount();
+    s32 val = AppAtomicFetch(&mValue);
+    u32 limit = 0;
+    if(cpus > 1) {
+        limit = ((u32) val >> ES_BUDGET_SHIFT) * 2 + 16;
+        limit = limit < G_FAST_MUTEX_SPIN_MAX ? limit : G_FAST_MUTEX_SPIN_MAX;
+    }
+    for(spins = 0; spins < limit; ++spins) {
+        if(0 == (val & ES_LOCKED)) {
+            s32 old = AppAtomicFetchCompareSet(val | ES_LOCKED, val, &mValue);
+            if(old == val) {
+                return true;
+            }
+            val = old;
+            continue;
+        }
+        AppCpuRelax();
+        val = AppAtomicFetch(&mValue);
+    }
+    return false;
+}
+
+
+void CFastMutex::updateBudget(u32 spins) {
+    s32 budget = (s32) ((u32) AppAtomicFetch(&mValue) >> ES_BUDGET_SHIFT);
+    s32 delta = ((s32) spins - budget) / 8;
+    if(delta) {
+        //only the holder changes the budget, state bits are not touched by the add.
+        AppAtomicFetchAdd((s32) ((u32) delta << ES_BUDGET_SHIFT), &mValue);
+    }
+}
+
+
+bool CFastMutex::waitLock(long milliseconds) {
+    const s64 deadline = milliseconds < 0 ? 0 : CThread::getTickCount() + milliseconds;
+    for(;;) {
+        s32 old = AppAtomicFetchOr(ES_MASK, &mValue);
+        if(0 == (old & ES_LOCKED)) {
+            return true;
+        }
+        long left = -1;
+        if(milliseconds >= 0) {
+            left = (long) (deadline - CThread::getTickCount());
+            if(left <= 0) {
+                return false;
+            }
+        }
+        AppFutexWait(&mValue, old | ES_MASK, left);
+    }
+}
+
+}//irr
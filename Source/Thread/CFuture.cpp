@@ -0,0 +1,280 @@
+#include "CFuture.h"
+#include "CThreadEvent.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+/**
+*@brief Wake a thread blocked in CFutureStateBase::wait().
+* It lives on the waiter's stack, mDone is the last thing touched by setter.
+*/
+class CFutureWaiter : public CFutureStateBase::IContinuation {
+public:
+    CFutureWaiter() : mDone(0) {
+        mEvent.init(0, false);
+    }
+
+    virtual void run()override {
+        mEvent.set();
+        AppAtomicFetchSet(1, &mDone);
+    }
+
+    CThreadEvent mEvent;
+    s32 mDone;
+};
+
+
+/**
+*@brief Shared by continuations of AppWhenAll() and AppWhenAny().
+*/
+class CFutureJoin {
+public:
+    class CNode : public CFutureStateBase::IContinuation {
+    public:
+        CNode(CFutureJoin* join, CFutureStateBase* state, u32 index) :
+            mJoin(join), mState(state), mIndex(index) {
+        }
+
+        virtual void run()override {
+            mJoin->onReady(mIndex, mState->isCancelled());
+            delete this;
+        }
+
+    private:
+        CFutureJoin* mJoin;
+        CFutureStateBase* mState;
+        u32 mIndex;
+    };
+
+    CFutureJoin(CFutureState<void>* all, CFutureState<u32>* any, u32 count) :
+        mAll(all),
+        mAny(any),
+        mPending((s32) count),
+        mCancelled(0) {
+        if(mAll) {
+            mAll->grab();
+        }
+        if(mAny) {
+            mAny->grab();
+        }
+    }
+
+    ~CFutureJoin() {
+        if(mAll) {
+            mAll->drop();
+        }
+        if(mAny) {
+            mAny->drop();
+        }
+    }
+
+    void add(CFutureStateBase* state, u32 index) {
+        CNode* node = new CNode(this, state, index);
+        if(!state->addContinuation(node)) {
+            node->run();
+        }
+    }
+
+    static void* operator new(size_t size) {
+        return CMemoryPool::allocate((u32) size);
+    }
+
+    static void operator delete(void* it, size_t size) {
+        CMemoryPool::release(it, (u32) size);
+    }
+
+private:
+    void onReady(u32 index, bool cancelled) {
+        if(cancelled) {
+            AppAtomicFetchSet(1, &mCancelled);
+        } else if(mAny) {
+            //only the first one success
+            mAny->setValue(index);
+        }
+        if(0 == AppAtomicDecrementFetch(&mPending)) {
+            //all is cancelled if any is cancelled, any is cancelled if all are cancelled.
+            if(mAll) {
+                if(AppAtomicFetch(&mCancelled)) {
+                    mAll->cancel();
+                } else {
+                    mAll->setValue();
+                }
+            }
+            if(mAny) {
+                mAny->cancel();
+            }
+            delete this;
+        }
+    }
+
+    CFutureState<void>* mAll;
+    CFutureState<u32>* mAny;
+    s32 mPending;
+    s32 mCancelled;     ///<1 if any state is cancelled
+};
+
+
+
+CFutureStateBase::CFutureStateBase(CThreadPool* pool) :
+    mRefCount(0),
+    mStatus(ES_PENDING),
+    mPool(pool),
+    mContinuations(0) {
+}
+
+
+CFutureStateBase::~CFutureStateBase() {
+    APP_ASSERT(0 == mContinuations);
+}
+
+
+void CFutureStateBase::grab() {
+    AppAtomicIncrementFetch(&mRefCount);
+}
+
+
+void CFutureStateBase::drop() {
+    if(0 == AppAtomicDecrementFetch(&mRefCount)) {
+        delete this;
+    }
+}
+
+
+bool CFutureStateBase::isReady()const {
+    return AppAtomicFetch((s32*) &mStatus) >= ES_READY;
+}
+
+
+bool CFutureStateBase::isCancelled()const {
+    return ES_CANCELLED == AppAtomicFetch((s32*) &mStatus);
+}
+
+
+bool CFutureStateBase::hasValue()const {
+    return ES_READY == AppAtomicFetch((s32*) &mStatus);
+}
+
+
+bool CFutureStateBase::cancel() {
+    if(!beginSet()) {
+        return false;
+    }
+    complete(ES_CANCELLED);
+    return true;
+}
+
+
+bool CFutureStateBase::beginSet() {
+    return ES_PENDING == AppAtomicFetchCompareSet(ES_SETTING, ES_PENDING, &mStatus);
+}
+
+
+void CFutureStateBase::setReady() {
+    complete(ES_READY);
+}
+
+
+void CFutureStateBase::complete(s32 status) {
+    IContinuation* head;
+    {
+        CAutoSpinlock ak(mLock);
+        AppAtomicFetchSet(status, &mStatus);
+        head = mContinuations;
+        mContinuations = 0;
+    }
+    //reverse to the order they were added
+    IContinuation* list = 0;
+    while(head) {
+        IContinuation* next = head->mNext;
+        head->mNext = list;
+        list = head;
+        head = next;
+    }
+    while(list) {
+        IContinuation* next = list->mNext;
+        list->run();
+        list = next;
+    }
+}
+
+
+bool CFutureStateBase::addContinuation(IContinuation* it) {
+    CAutoSpinlock ak(mLock);
+    if(AppAtomicFetch(&mStatus) >= ES_READY) {
+        return false;
+    }
+    it->mNext = mContinuations;
+    mContinuations = it;
+    return true;
+}
+
+
+void CFutureStateBase::wait() {
+    //help the pool first, most waits end here without blocking.
+    while(!isReady()) {
+        if(!mPool || !mPool->runOneTask()) {
+            break;
+        }
+    }
+    if(isReady()) {
+        return;
+    }
+    CFutureWaiter waiter;
+    if(!addContinuation(&waiter)) {
+        return;
+    }
+    waiter.mEvent.wait();
+    //the setter is leaving waiter.run().
+    while(0 == AppAtomicFetch(&waiter.mDone)) {
+        CThread::yield();
+    }
+}
+
+
+CFuture<void> AppWhenAll(CFutureStateBase* const* states, u32 count) {
+    CThreadPool* pool = 0;
+    u32 valid = 0;
+    for(u32 i = 0; i < count; ++i) {
+        if(states[i]) {
+            pool = pool ? pool : states[i]->getPool();
+            ++valid;
+        }
+    }
+    CFuture<void> ret(new CFutureState<void>(pool));
+    if(0 == valid) {
+        ret.getState()->setValue();
+        return ret;
+    }
+    CFutureJoin* join = new CFutureJoin(ret.getState(), 0, valid);
+    for(u32 i = 0; i < count; ++i) {
+        if(states[i]) {
+            join->add(states[i], i);
+        }
+    }
+    return ret;
+}
+
+
+CFuture<u32> AppWhenAny(CFutureStateBase* const* states, u32 count) {
+    CThreadPool* pool = 0;
+    u32 valid = 0;
+    for(u32 i = 0; i < count; ++i) {
+        if(states[i]) {
+            pool = pool ? pool : states[i]->getPool();
+            ++valid;
+        }
+    }
+    if(0 == valid) {
+        return CFuture<u32>();
+    }
+    CFuture<u32> ret(new CFutureState<u32>(pool));
+    CFutureJoin* join = new CFutureJoin(0, ret.getState(), valid);
+    for(u32 i = 0; i < count; ++i) {
+        if(states[i]) {
+            join->add(states[i], i);
+        }
+    }
+    return ret;
+}
+
+}//irr
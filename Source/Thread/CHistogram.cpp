@@ -0,0 +1,91 @@
+#include "CHistogram.h"
+#include <string.h>
+#if defined(APP_PLATFORM_WINDOWS)
+#include <intrin.h>
+#endif
+
+namespace irr {
+
+///index of the highest set bit, value must not be 0
+static u32 AppHighBit(u64 value) {
+#if defined(APP_PLATFORM_WINDOWS)
+    unsigned long ret;
+    _BitScanReverse64(&ret, value);
+    return (u32) ret;
+#else
+    return 63U - (u32) __builtin_clzll(value);
+#endif
+}
+
+
+void CHistogram::clear() {
+    mCount = 0;
+    mSum = 0;
+    mMax = 0;
+    ::memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+
+void CHistogram::merge(const CHistogram& it) {
+    for(u32 i = 0; i < EBUCKET_COUNT; ++i) {
+        AppCounterAdd(&mBuckets[i], it.getBucketCount(i));
+    }
+    AppCounterAdd(&mCount, it.getCount());
+    AppCounterAdd(&mSum, AppAtomicLoadRelaxed(&it.mSum));
+    const u64 high = it.getMax();
+    if(high > mMax) {
+        AppAtomicStoreRelaxed(high, &mMax);
+    }
+}
+
+
+u64 CHistogram::getPercentile(f64 percent)const {
+    const u64 cnt = getCount();
+    const u64 high = getMax();
+    if(0 == cnt) {
+        return 0;
+    }
+    u64 rank = (u64) (percent * cnt / 100.0 + 0.5);
+    rank = rank > 0 ? rank : 1;
+    u64 sum = 0;
+    for(u32 i = 0; i < EBUCKET_COUNT; ++i) {
+        sum += getBucketCount(i);
+        if(sum >= rank) {
+            u64 ret = getBucketHigh(i);
+            return ret < high ? ret : high;
+        }
+    }
+    return high;
+}
+
+
+u32 CHistogram::getBucket(u64 value) {
+    if(value < ESUB_COUNT) {
+        return (u32) value;
+    }
+    if(value >> EMAX_BITS) {
+        return EBUCKET_COUNT - 1;
+    }
+    const u32 high = AppHighBit(value);
+    return ((high - ESUB_BITS + 1) << ESUB_BITS) + (u32) ((value >> (high - ESUB_BITS)) & ESUB_MASK);
+}
+
+
+u64 CHistogram::getBucketLow(u32 bucket) {
+    if(bucket < ESUB_COUNT) {
+        return bucket;
+    }
+    const u32 shift = (bucket >> ESUB_BITS) - 1;
+    return (u64) (ESUB_COUNT + (bucket & ESUB_MASK)) << shift;
+}
+
+
+u64 CHistogram::getBucketHigh(u32 bucket) {
+    if(bucket < ESUB_COUNT) {
+        return bucket;
+    }
+    const u32 shift = (bucket >> ESUB_BITS) - 1;
+    return getBucketLow(bucket) + ((u64) 1 << shift) - 1;
+}
+
+}//irr
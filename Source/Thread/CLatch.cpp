@@ -0,0 +1,51 @@
+#include "CLatch.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+CLatch::CLatch(u32 count) :
+    mCount((s32) count) {
+    mEvent.init(0, false);
+    if(0 == count) {
+        mEvent.set();
+    }
+}
+
+
+CLatch::~CLatch() {
+}
+
+
+void CLatch::reset(u32 count) {
+    mEvent.reset();
+    AppAtomicFetchSet((s32) count, &mCount);
+    if(0 == count) {
+        mEvent.set();
+    }
+}
+
+
+void CLatch::countDown() {
+    if(0 == AppAtomicDecrementFetch(&mCount)) {
+        mEvent.set();
+    }
+}
+
+
+bool CLatch::isOpen()const {
+    return AppAtomicFetch((s32*) &mCount) <= 0;
+}
+
+
+void CLatch::wait() {
+    if(!isOpen()) {
+        mEvent.wait();
+    }
+}
+
+
+bool CLatch::wait(long milliseconds) {
+    return isOpen() || mEvent.wait(milliseconds);
+}
+
+}//irr
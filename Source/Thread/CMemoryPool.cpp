@@ -0,0 +1,98 @@
+#include "CMemoryPool.h"
+#include <new>
+
+namespace irr {
+
+///size classes of global pools.
+static const u32 G_POOL_SIZE_MIN = 32;
+static const u32 G_POOL_SIZE_MAX = 512;
+
+
+CMemoryPool::CMemoryPool(u32 blockSize, u32 blocksPerChunk/* = 64*/) :
+    mBlockSize((blockSize + sizeof(void*) - 1) & ~(u32) (sizeof(void*) - 1)),
+    mBlocksPerChunk(blocksPerChunk > 0 ? blocksPerChunk : 1),
+    mFree(0),
+    mChunks(0) {
+    if(mBlockSize < sizeof(SBlock)) {
+        mBlockSize = sizeof(SBlock);
+    }
+}
+
+
+CMemoryPool::~CMemoryPool() {
+    while(mChunks) {
+        SBlock* chunk = mChunks;
+        mChunks = chunk->mNext;
+        ::operator delete(chunk);
+    }
+}
+
+
+void* CMemoryPool::allocate() {
+    CAutoSpinlock ak(mLock);
+    if(!mFree) {
+        //the first block of chunk links all chunks.
+        const u32 head = (sizeof(SBlock) + 15) & ~15U;
+        s8* chunk = (s8*)::operator new(head + mBlockSize * mBlocksPerChunk);
+        ((SBlock*) chunk)->mNext = mChunks;
+        mChunks = (SBlock*) chunk;
+        for(u32 i = 0; i < mBlocksPerChunk; ++i) {
+            SBlock* nd = (SBlock*) (chunk + head + i * mBlockSize);
+            nd->mNext = mFree;
+            mFree = nd;
+        }
+    }
+    SBlock* ret = mFree;
+    mFree = ret->mNext;
+    return ret;
+}
+
+
+void CMemoryPool::release(void* it) {
+    if(it) {
+        CAutoSpinlock ak(mLock);
+        ((SBlock*) it)->mNext = mFree;
+        mFree = (SBlock*) it;
+    }
+}
+
+
+CMemoryPool* CMemoryPool::getPool(u32 size) {
+    static CMemoryPool pool32(32);
+    static CMemoryPool pool64(64);
+    static CMemoryPool pool128(128);
+    static CMemoryPool pool256(256);
+    static CMemoryPool pool512(512, 32);
+    if(size <= 32) {
+        return &pool32;
+    }
+    if(size <= 64) {
+        return &pool64;
+    }
+    if(size <= 128) {
+        return &pool128;
+    }
+    if(size <= 256) {
+        return &pool256;
+    }
+    return &pool512;
+}
+
+
+void* CMemoryPool::allocate(u32 size) {
+    if(size > G_POOL_SIZE_MAX) {
+        return ::operator new(size);
+    }
+    return getPool(size)->allocate();
+}
+
+
+void CMemoryPool::release(void* it, u32 size) {
+    if(size > G_POOL_SIZE_MAX) {
+        ::operator delete(it);
+        return;
+    }
+    getPool(size)->release(it);
+}
+
+}//irr
@@ -0,0 +1,84 @@
+#include "CParallelJob.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+CParallelJob::CParallelJob(CThreadPool& pool, s32 begin, s32 end, s32 grain) :
+    mPool(pool),
+    mNext(begin),
+    mEnd(end),
+    mGrain(grain > 0 ? grain : 1),
+    mDivisor(2),
+    mPending(0) {
+}
+
+
+CParallelJob::~CParallelJob() {
+    APP_ASSERT(0 == mPending);
+}
+
+
+void CParallelJob::execute() {
+    if(mNext >= mEnd) {
+        return;
+    }
+    u32 chunks = (u32) ((mEnd - mNext + mGrain - 1) / mGrain);
+    u32 helpers = core::min_(mPool.getMaxThreads(), chunks - 1);
+    mDivisor = 2 * (helpers + 1);
+    if(helpers > 0) {
+        mPending = (s32) helpers;
+        CTaskBatch batch(mPool);
+        for(u32 i = 0; i < helpers; ++i) {
+            batch.add(this);
+        }
+        batch.flush();
+        if(batch.getRejected() > 0) {
+            AppAtomicFetchAdd(-(s32) batch.getRejected(), &mPending);
+        }
+    }
+
+    work();
+
+    //helpers may still be queued, run other tasks until they finished.
+    while(AppAtomicFetch(&mPending) > 0) {
+        if(!mPool.runOneTask()) {
+            CThread::yield();
+        }
+    }
+}
+
+
+void CParallelJob::run() {
+    work();
+    //@note: the job may be destroyed by caller right after this.
+    AppAtomicDecrementFetch(&mPending);
+}
+
+
+void CParallelJob::cancel() {
+    //@note: the job may be destroyed by caller right after this.
+    AppAtomicDecrementFetch(&mPending);
+}
+
+
+bool CParallelJob::next(s32& begin, s32& end) {
+    s32 curr = AppAtomicFetch(&mNext);
+    for(;;) {
+        if(curr >= mEnd) {
+            return false;
+        }
+        s32 size = (mEnd - curr) / mDivisor;
+        if(size < mGrain) {
+            size = core::min_(mGrain, mEnd - curr);
+        }
+        s32 old = AppAtomicFetchCompareSet(curr + size, curr, &mNext);
+        if(old == curr) {
+            begin = curr;
+            end = curr + size;
+            return true;
+        }
+        curr = old;
+    }
+}
+
+}//irr
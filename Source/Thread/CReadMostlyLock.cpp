@@ -0,0 +1,132 @@
+#include "CReadMostlyLock.h"
+#include "HAtomicOperator.h"
+#include "CThread.h"
+
+namespace irr {
+
+///round robin counter of reader slots
+static s32 G_READ_SLOT_NEXT = 0;
+
+///reader slot index of current thread, -1 if not assigned
+static thread_local s32 G_READ_SLOT = -1;
+
+
+/**
+*@brief Wait a round, pause first, then yield, then sleep if the lock is held long.
+*/
+static void AppReadMostlyBackoff(u32& round) {
+    if(round < 10) {
+        for(u32 i = 0; i < (1U << round); ++i) {
+            AppCpuRelax();
+        }
+    } else if(round < 100) {
+        CThread::yield();
+    } else {
+        CThread::sleep(1);
+    }
+    ++round;
+}
+
+
+CReadMostlyLock::CReadMostlyLock(u32 slots) :
+    mWriter(0) {
+    if(0 == slots) {
+        slots = CThread::getProcessorCount();
+    }
+    u32 cnt = 1;
+    while(cnt < slots) {
+        cnt <<= 1;
+    }
+    mMask = cnt - 1;
+    mBuffer = new s8[(cnt + 1) * sizeof(SSlot)];
+    mSlots = (SSlot*) (((size_t) mBuffer + APP_CACHE_LINE_SIZE - 1) & ~(size_t) (APP_CACHE_LINE_SIZE - 1));
+    for(u32 i = 0; i < cnt; ++i) {
+        mSlots[i].mReaders = 0;
+    }
+}
+
+
+CReadMostlyLock::~CReadMostlyLock() {
+    delete[] mBuffer;
+}
+
+
+CReadMostlyLock::SSlot& CReadMostlyLock::getSlot() {
+    if(G_READ_SLOT < 0) {
+        G_READ_SLOT = AppAtomicFetchAdd(1, &G_READ_SLOT_NEXT) & 0x7FFFFFFF;
+    }
+    return mSlots[G_READ_SLOT & mMask];
+}
+
+
+void CReadMostlyLock::lockRead() {
+    SSlot& slot = getSlot();
+    for(u32 round = 0; ; ) {
+        //the counter is published before reading writer flag, pairs with lockWrite().
+        AppAtomicIncrementFetch(&slot.mReaders);
+        if(0 == AppAtomicFetch(&mWriter)) {
+            return;
+        }
+        AppAtomicDecrementFetch(&slot.mReaders);
+        while(AppAtomicFetch(&mWriter)) {
+            AppReadMostlyBackoff(round);
+        }
+    }
+}
+
+
+bool CReadMostlyLock::tryLockRead() {
+    if(AppAtomicFetch(&mWriter)) {
+        return false;
+    }
+    SSlot& slot = getSlot();
+    AppAtomicIncrementFetch(&slot.mReaders);
+    if(0 == AppAtomicFetch(&mWriter)) {
+        return true;
+    }
+    AppAtomicDecrementFetch(&slot.mReaders);
+    return false;
+}
+
+
+void CReadMostlyLock::unlockRead() {
+    AppAtomicDecrementFetch(&getSlot().mReaders);
+}
+
+
+void CReadMostlyLock::lockWrite() {
+    for(u32 round = 0; 0 != AppAtomicFetchCompareSet(1, 0, &mWriter); ) {
+        AppReadMostlyBackoff(round);
+    }
+    waitReaders();
+}
+
+
+bool CReadMostlyLock::tryLockWrite() {
+    if(0 != AppAtomicFetchCompareSet(1, 0, &mWriter)) {
+        return false;
+    }
+    for(u32 i = 0; i <= mMask; ++i) {
+        if(AppAtomicFetch(&mSlots[i].mReaders)) {
+            AppAtomicFetchSet(0, &mWriter);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void CReadMostlyLock::unlockWrite() {
+    AppAtomicFetchSet(0, &mWriter);
+}
+
+
+void CReadMostlyLock::waitReaders() {
+    for(u32 i = 0; i <= mMask; ++i) {
+        for(u32 round = 0; AppAtomicFetch(&mSlots[i].mReaders); ) {
+            AppReadMostlyBackoff(round);
+        }
+    }
+}
+
+}//irr
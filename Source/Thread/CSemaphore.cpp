@@ -165,7 +165,7 @@ void CSemaphore::wait() {
         }
     }
     if(0 == ret) {
-        --mValue;
+        mValue = mValue - 1;
     }
     pthread_mutex_unlock(&mMutex);
 }
@@ -220,7 +220,7 @@ bool CSemaphore::wait(long milliseconds) {
         }
     }
 
-    if(rc == 0) --mValue;
+    if(rc == 0) mValue = mValue - 1;
 
     pthread_mutex_unlock(&mMutex);
     return rc == 0;
@@ -231,7 +231,7 @@ void CSemaphore::set() {
         return; //("cannot signal semaphore (lock)");
 
     if(mValue < mMax) {
-        ++mValue;
+        mValue = mValue + 1;
     } else {
         pthread_mutex_unlock(&mMutex);
         return; //("cannot signal semaphore: count would exceed maximum");
@@ -0,0 +1,61 @@
+#include "CSeqLock.h"
+#include "HAtomicOperator.h"
+#include "CThread.h"
+
+namespace irr {
+
+///spin rounds before yielding CPU to a slow writer
+static const u32 G_SEQ_LOCK_SPIN = 64;
+
+
+u32 CSeqLock::beginRead()const {
+    for(u32 round = 0; ; ++round) {
+        u32 seq = (u32) AppAtomicFetch((s32*) &mSequence);
+        if(0 == (seq & 1)) {
+            return seq;
+        }
+        if(round < G_SEQ_LOCK_SPIN) {
+            AppCpuRelax();
+        } else {
+            CThread::yield();
+        }
+    }
+}
+
+
+bool CSeqLock::endRead(u32 sequence)const {
+    //payload loads must be done before the sequence is read again.
+    AppAtomicReadBarrier();
+    return sequence == (u32) AppAtomicFetch((s32*) &mSequence);
+}
+
+
+void CSeqLock::lockWrite() {
+    for(u32 round = 0; !tryLockWrite(); ++round) {
+        if(round < G_SEQ_LOCK_SPIN) {
+            AppCpuRelax();
+        } else {
+            CThread::yield();
+        }
+    }
+}
+
+
+bool CSeqLock::tryLockWrite() {
+    //the CAS is a full barrier, payload stores can't move before it.
+    s32 seq = AppAtomicFetch(&mSequence);
+    return 0 == (seq & 1) && seq == AppAtomicFetchCompareSet((s32) ((u32) seq + 1), seq, &mSequence);
+}
+
+
+void CSeqLock::unlockWrite() {
+    //publish the payload with an even sequence.
+    AppAtomicFetchAdd(1, &mSequence);
+}
+
+
+u32 CSeqLock::getSequence()const {
+    return (u32) AppAtomicFetch((s32*) &mSequence);
+}
+
+}//irr
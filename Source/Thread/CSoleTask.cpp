@@ -0,0 +1,63 @@
+#include "CSoleTask.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+CSoleTask::CSoleTask(CThreadPool& pool, AppCallable iFunc, void* iData, ETaskPriority iPriority) :
+    mPending(0),
+    mSignals(0),
+    mPool(pool),
+    mPriority(iPriority),
+    mTarget(iFunc, iData) {
+}
+
+
+CSoleTask::CSoleTask(CThreadPool& pool, IRunnable* it, ETaskPriority iPriority) :
+    mPending(0),
+    mSignals(0),
+    mPool(pool),
+    mPriority(iPriority),
+    mTarget(it) {
+}
+
+
+CSoleTask::~CSoleTask() {
+}
+
+
+bool CSoleTask::signal() {
+    AppAtomicIncrementFetch(&mSignals);
+    if(0 != AppAtomicFetch(&mPending) || 0 != AppAtomicFetchSet(1, &mPending)) {
+        return true;//coalesced
+    }
+    if(!mPool.addTask(this, mPriority)) {
+        AppAtomicFetchSet(0, &mPending);
+        return false;
+    }
+    return true;
+}
+
+
+bool CSoleTask::isPending()const {
+    return 0 != AppAtomicFetch((s32*) &mPending);
+}
+
+
+u32 CSoleTask::getSignals()const {
+    return (u32) AppAtomicFetch((s32*) &mSignals);
+}
+
+
+void CSoleTask::run() {
+    //clear first, signals from now on need a new run.
+    AppAtomicFetchSet(0, &mSignals);
+    AppAtomicFetchSet(0, &mPending);
+    mTarget();
+}
+
+
+void CSoleTask::cancel() {
+    AppAtomicFetchSet(0, &mPending);
+}
+
+}//irr
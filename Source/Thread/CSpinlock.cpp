@@ -1,8 +1,49 @@
 #include "CSpinlock.h"
 #include "HAtomicOperator.h"
+#include "CThread.h"
 
 namespace irr {
 
+/**
+* @brief Exponential backoff of spin-wait, pauses are doubled each round
+* until the limit, then CPU is yielded, the holder may be preempted.
+*/
+class CSpinBackoff {
+public:
+    CSpinBackoff() : mCount(1) {
+    }
+
+    void pause() {
+        if(mCount <= ESPIN_MAX) {
+            for(u32 i = 0; i < mCount; ++i) {
+                AppCpuRelax();
+            }
+            mCount <<= 1;
+        } else {
+            CThread::yield();
+        }
+    }
+
+    /**
+    * @brief Pause about count rounds, yield if too many.
+    */
+    static void pause(u32 count) {
+        if(count <= ESPIN_MAX) {
+            for(u32 i = 0; i < count; ++i) {
+                AppCpuRelax();
+            }
+        } else {
+            CThread::yield();
+        }
+    }
+
+private:
+    enum {
+        ESPIN_MAX = 1024
+    };
+    u32 mCount;
+};
+
 
 CSpinlock::CSpinlock() :
     mValue(0) {
@@ -14,20 +55,181 @@ CSpinlock::~CSpinlock() {
 
 
 void CSpinlock::lock() {
-    while(AppAtomicFetchCompareSet(1, 0, &mValue)) {
-        //busy waiting
+    if(0 == AppAtomicFetchCompareSet(1, 0, &mValue)) {
+        return;
+    }
+    CSpinBackoff backoff;
+    for(;;) {
+        //spin on read, the line stays shared until the holder writes it.
+        while(AppAtomicFetch(&mValue)) {
+            backoff.pause();
+        }
+        if(0 == AppAtomicFetchCompareSet(1, 0, &mValue)) {
+            return;
+        }
+        backoff.pause();
     }
 }
 
 
 bool CSpinlock::trylock() {
-    return 0 == AppAtomicFetchCompareSet(1, 0, &mValue);
+    return 0 == AppAtomicFetch(&mValue) && 0 == AppAtomicFetchCompareSet(1, 0, &mValue);
 }
 
 
 void CSpinlock::unlock() {
-    AppAtomicFetchCompareSet(0, 1, &mValue);
+    AppAtomicFetchSet(0, &mValue);
+}
+
+
+
+CTicketLock::CTicketLock() :
+    mNext(0),
+    mServing(0) {
+}
+
+
+CTicketLock::~CTicketLock() {
+}
+
+
+void CTicketLock::lock() {
+    const s32 ticket = AppAtomicFetchAdd(1, &mNext);
+    for(;;) {
+        //subtract in unsigned, tickets wrap around.
+        u32 distance = (u32) ticket - (u32) AppAtomicFetch(&mServing);
+        if(0 == distance) {
+            return;
+        }
+        CSpinBackoff::pause(distance * 32);
+    }
+}
+
+
+bool CTicketLock::trylock() {
+    s32 serving = AppAtomicFetch(&mServing);
+    return serving == AppAtomicFetchCompareSet((s32) ((u32) serving + 1), serving, &mNext);
+}
+
+
+void CTicketLock::unlock() {
+    //only the holder writes mServing
+    AppAtomicFetchSet((s32) ((u32) mServing + 1), &mServing);
+}
+
+
+
+///a node owns a whole cache line, new of an over-aligned type is aligned since C++17.
+struct alignas(APP_CACHE_LINE_SIZE) CMCSLock::SNode {
+    SNode* mNext;       ///<next waiter, or next free node in cache
+    s32 mLocked;
+
+#if !defined(__cpp_aligned_new)
+    //the heap block is kept just before the aligned node.
+    static void* operator new(size_t size) {
+        u8* block = (u8*) ::operator new(size + APP_CACHE_LINE_SIZE);
+        u8* ret = block + APP_CACHE_LINE_SIZE - ((size_t) block & (APP_CACHE_LINE_SIZE - 1));
+        ((void**) ret)[-1] = block;
+        return ret;
+    }
+
+    static void operator delete(void* it) {
+        ::operator delete(((void**) it)[-1]);
+    }
+#endif
+};
+
+
+///free queue nodes of current thread
+class CMCSNodeCache {
+public:
+    CMCSNodeCache() : mHead(0) {
+    }
+
+    ~CMCSNodeCache() {
+        while(mHead) {
+            CMCSLock::SNode* it = mHead;
+            mHead = it->mNext;
+            delete it;
+        }
+    }
+
+    CMCSLock::SNode* pop() {
+        CMCSLock::SNode* it = mHead;
+        if(it) {
+            mHead = it->mNext;
+        } else {
+            it = new CMCSLock::SNode();
+        }
+        it->mNext = 0;
+        it->mLocked = 1;
+        return it;
+    }
+
+    void push(CMCSLock::SNode* it) {
+        it->mNext = mHead;
+        mHead = it;
+    }
+
+private:
+    CMCSLock::SNode* mHead;
+};
+
+static thread_local CMCSNodeCache G_MCS_NODES;
+
+
+CMCSLock::CMCSLock() :
+    mTail(0),
+    mHolder(0) {
+}
+
+
+CMCSLock::~CMCSLock() {
+}
+
+
+void CMCSLock::lock() {
+    SNode* node = G_MCS_NODES.pop();
+    SNode* prev = (SNode*) AppAtomicFetchSet((void*) node, &mTail);
+    if(prev) {
+        AppAtomicFetchSet((void*) node, (void**) &prev->mNext);
+        CSpinBackoff backoff;
+        while(AppAtomicFetch(&node->mLocked)) {
+            backoff.pause();
+        }
+    }
+    mHolder = node;
+}
+
+
+bool CMCSLock::trylock() {
+    SNode* node = G_MCS_NODES.pop();
+    if(0 != AppAtomicFetchCompareSet((void*) node, (void*) 0, &mTail)) {
+        G_MCS_NODES.push(node);
+        return false;
+    }
+    mHolder = node;
+    return true;
+}
+
+
+void CMCSLock::unlock() {
+    SNode* node = mHolder;
+    SNode* next = (SNode*) AppAtomicFetch((void**) &node->mNext);
+    if(!next) {
+        if(node == AppAtomicFetchCompareSet((void*) 0, (void*) node, &mTail)) {
+            G_MCS_NODES.push(node);
+            return;
+        }
+        //a waiter swapped the tail but hasn't linked itself yet.
+        CSpinBackoff backoff;
+        while(0 == (next = (SNode*) AppAtomicFetch((void**) &node->mNext))) {
+            backoff.pause();
+        }
+    }
+    AppAtomicFetchSet(0, &next->mLocked);
+    G_MCS_NODES.push(node);
 }
 
 
-} //namespace irr
\ No newline at end of file
+} //namespace irr
@@ -0,0 +1,180 @@
+#include "CStrand.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+///spins before yield, when a producer is preempted in linking
+static const u32 G_STRAND_SPIN = 64;
+
+static CStrand::SNode* AppLoadNext(CStrand::SNode* it) {
+    CStrand::SNode* ret = *(CStrand::SNode* volatile*) &it->mNext;
+    AppAtomicReadBarrier();
+    return ret;
+}
+
+
+CStrand::CStrand(CThreadPool& pool, u32 batch, ETaskPriority iPriority) :
+    mCount(0),
+    mBatch(batch > 0 ? batch : 1),
+    mPriority(iPriority),
+    mPool(pool),
+    mHead(&mStub),
+    mTail(&mStub) {
+    ::memset(mCache, 0, sizeof(mCache));
+}
+
+
+CStrand::~CStrand() {
+    for(SNode* it = pop(); it; it = pop()) {
+        it->mTask.discard();
+        delete it;
+    }
+    for(u32 i = 0; i < ECACHE_SIZE; ++i) {
+        delete mCache[i];
+    }
+}
+
+
+bool CStrand::post(AppCallable iFunc, void* iData) {
+    return iFunc && post(SThreadTask(iFunc, iData));
+}
+
+
+bool CStrand::post(IRunnable* it) {
+    return it && post(SThreadTask(it));
+}
+
+
+bool CStrand::post(CTask&& it) {
+    return it.isValid() && post(it.release());
+}
+
+
+bool CStrand::post(SThreadTask&& it) {
+    SNode* node = createNode();
+    node->mTask = std::move(it);
+    push(node);
+    if(1 == AppAtomicIncrementFetch(&mCount)) {
+        //the first pending task schedules the strand.
+        if(!mPool.addTask(this, mPriority)) {
+            while(!drain()) {
+            }
+        }
+    }
+    return true;
+}
+
+
+CStrand::SNode* CStrand::createNode() {
+    for(u32 i = 0; i < ECACHE_SIZE; ++i) {
+        if(AppAtomicFetch((void**) &mCache[i])) {
+            SNode* ret = (SNode*) AppAtomicFetchSet((void*) 0, (void**) &mCache[i]);
+            if(ret) {
+                return ret;
+            }
+        }
+    }
+    return new SNode();
+}
+
+
+void CStrand::releaseNode(SNode* it) {
+    for(u32 i = 0; i < ECACHE_SIZE; ++i) {
+        if(0 == AppAtomicFetch((void**) &mCache[i])
+            && 0 == AppAtomicFetchCompareSet((void*) it, (void*) 0, (void**) &mCache[i])) {
+            return;
+        }
+    }
+    delete it;
+}
+
+
+void CStrand::push(SNode* it) {
+    it->mNext = 0;
+    SNode* prev = (SNode*) AppAtomicFetchSet((void*) it, (void**) &mTail);
+    //the node is visible to consumer from now on.
+    *(SNode* volatile*) &prev->mNext = it;
+}
+
+
+CStrand::SNode* CStrand::pop() {
+    SNode* head = mHead;
+    SNode* next = AppLoadNext(head);
+    if(&mStub == head) {
+        if(!next) {
+            return 0;
+        }
+        mHead = next;
+        head = next;
+        next = AppLoadNext(next);
+    }
+    if(next) {
+        mHead = next;
+        return head;
+    }
+    if(head != *(SNode* volatile*) &mTail) {
+        return 0;//a producer is linking.
+    }
+    push(&mStub);
+    next = AppLoadNext(head);
+    if(next) {
+        mHead = next;
+        return head;
+    }
+    return 0;
+}
+
+
+u32 CStrand::getWaitingTasks()const {
+    s32 ret = AppAtomicFetch((s32*) &mCount);
+    return ret > 0 ? (u32) ret : 0;
+}
+
+
+SThreadTask CStrand::take() {
+    SNode* it;
+    //mCount > 0 promises a task, it may be in linking.
+    for(u32 round = 0; 0 == (it = pop()); ++round) {
+        if(round < G_STRAND_SPIN) {
+            AppCpuRelax();
+        } else {
+            CThread::yield();
+        }
+    }
+    SThreadTask ret(std::move(it->mTask));
+    releaseNode(it);
+    return ret;
+}
+
+
+bool CStrand::drain() {
+    for(s32 done = 0; done < (s32) mBatch; ++done) {
+        SThreadTask task = take();
+        task();
+        if(1 == AppAtomicFetchAdd(-1, &mCount)) {
+            return true;
+        }
+    }
+    return mPool.addTask(this, mPriority);
+}
+
+
+void CStrand::run() {
+    while(!drain()) {
+        //rejected by pool, go on in this worker.
+    }
+}
+
+
+void CStrand::cancel() {
+    //the scheduled run was dropped by pool, drop tasks as the consumer until none left.
+    for(;;) {
+        SThreadTask task = take();
+        task.discard();
+        if(1 == AppAtomicFetchAdd(-1, &mCount)) {
+            return;
+        }
+    }
+}
+
+}//irr
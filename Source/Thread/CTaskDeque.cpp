@@ -0,0 +1,96 @@
+#include "CTaskDeque.h"
+#include "HAtomicOperator.h"
+#include <utility>
+
+namespace irr {
+
+CTaskDeque::CTaskDeque() :
+    mTop(0),
+    mBottom(0),
+    mMask(0),
+    mTasks(0) {
+}
+
+
+CTaskDeque::~CTaskDeque() {
+    delete[] mTasks;
+}
+
+
+void CTaskDeque::init(u32 capacity) {
+    u32 cnt = 2;
+    while(cnt < capacity) {
+        cnt <<= 1;
+    }
+    delete[] mTasks;
+    mTasks = new SThreadTask[cnt];
+    mMask = cnt - 1;
+    mTop = 0;
+    mBottom = 0;
+}
+
+
+bool CTaskDeque::push(SThreadTask&& it) {
+    u32 bottom = (u32) mBottom;
+    u32 top = (u32) AppAtomicFetch(&mTop);
+    if((s32) (bottom - top) > (s32) mMask) {
+        return false;//full
+    }
+    //a stolen slot keeps the bytes of task owned by thief, overwrite it by bytes.
+    it.box();
+    ::memcpy((void*) (mTasks + (bottom & mMask)), (const void*) &it, sizeof(it));
+    it.mType = SThreadTask::ETT_NONE;
+    //publish the task to thieves.
+    AppAtomicFetchSet((s32) (bottom + 1), &mBottom);
+    return true;
+}
+
+
+bool CTaskDeque::pop(SThreadTask& it) {
+    u32 bottom = (u32) mBottom - 1;
+    //the exchange is a full barrier, the store must be visible before reading top.
+    AppAtomicFetchSet((s32) bottom, &mBottom);
+    u32 top = (u32) AppAtomicFetch(&mTop);
+    s32 count = (s32) (bottom - top);
+    if(count < 0) {//empty
+        AppAtomicFetchSet((s32) (bottom + 1), &mBottom);
+        return false;
+    }
+    if(count > 0) {
+        it = std::move(mTasks[bottom & mMask]);
+        return true;
+    }
+    //the last one, race against thieves, take it only if won.
+    bool ret = ((s32) top == AppAtomicFetchCompareSet((s32) (top + 1), (s32) top, &mTop));
+    if(ret) {
+        it = std::move(mTasks[bottom & mMask]);
+    }
+    AppAtomicFetchSet((s32) (bottom + 1), &mBottom);
+    return ret;
+}
+
+
+bool CTaskDeque::steal(SThreadTask& it) {
+    u32 top = (u32) AppAtomicFetch(&mTop);
+    u32 bottom = (u32) AppAtomicFetch(&mBottom);
+    if((s32) (bottom - top) <= 0) {
+        return false;
+    }
+    //the slot can't be reused by owner until top moved, so a copy is safe when CAS success.
+    //the slot may be written by owner if CAS fails, copy the bytes only.
+    SThreadTask task;
+    ::memcpy((void*) &task, (const void*) (mTasks + (top & mMask)), sizeof(task));
+    if((s32) top != AppAtomicFetchCompareSet((s32) (top + 1), (s32) top, &mTop)) {
+        return false;
+    }
+    it = std::move(task);
+    return true;
+}
+
+
+u32 CTaskDeque::size()const {
+    s32 count = (s32) ((u32) AppAtomicFetch((s32*) &mBottom) - (u32) AppAtomicFetch((s32*) &mTop));
+    return count > 0 ? (u32) count : 0;
+}
+
+}//irr
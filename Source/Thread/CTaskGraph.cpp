@@ -0,0 +1,204 @@
+#include "CTaskGraph.h"
+#include "HAtomicOperator.h"
+
+namespace irr {
+
+void CTaskGraph::SNode::run() {
+    mGraph->runReady(this);
+}
+
+
+void CTaskGraph::SNode::cancel() {
+    AppAtomicFetchSet(1, &mGraph->mCancelled);
+    mGraph->runReady(this);
+}
+
+
+CTaskGraph::CTaskGraph() :
+    mPool(0),
+    mRemaining(0),
+    mActive(0),
+    mCancelled(0),
+    mChecked(true),
+    mValid(true) {
+    mFinished.init(0, false);
+}
+
+
+CTaskGraph::~CTaskGraph() {
+    wait();
+    clear();
+}
+
+
+void CTaskGraph::clear() {
+    if(isRunning()) {
+        return;
+    }
+    for(u32 i = 0; i < mNodes.size(); ++i) {
+        delete mNodes[i];
+    }
+    mNodes.clear();
+    mChecked = true;
+    mValid = true;
+}
+
+
+u32 CTaskGraph::addNode(const SThreadTask& it) {
+    if(isRunning()) {
+        return ENODE_INVALID;
+    }
+    SNode* nd = new SNode();
+    nd->mGraph = this;
+    nd->mTask = it;
+    nd->mNextReady = 0;
+    nd->mPending = 0;
+    nd->mPredecessors = 0;
+    mNodes.push_back(nd);
+    return mNodes.size() - 1;
+}
+
+
+u32 CTaskGraph::addNode(AppCallable iFunc, void* iData/* = 0*/) {
+    if(!iFunc) {
+        return ENODE_INVALID;
+    }
+    return addNode(SThreadTask(iFunc, iData));
+}
+
+
+u32 CTaskGraph::addNode(IRunnable* it) {
+    if(!it) {
+        return ENODE_INVALID;
+    }
+    return addNode(SThreadTask(it));
+}
+
+
+bool CTaskGraph::addEdge(u32 iFrom, u32 iTo) {
+    if(iFrom >= mNodes.size() || iTo >= mNodes.size() || iFrom == iTo || isRunning()) {
+        return false;
+    }
+    mNodes[iFrom]->mSuccessors.push_back(iTo);
+    ++mNodes[iTo]->mPredecessors;
+    mChecked = false;
+    return true;
+}
+
+
+bool CTaskGraph::checkCycle() {
+    if(mChecked) {
+        return mValid;
+    }
+    //Kahn's algorithm, all nodes can be visited if no cycle.
+    core::array<u32> pending(mNodes.size());
+    core::array<u32> ready(mNodes.size());
+    for(u32 i = 0; i < mNodes.size(); ++i) {
+        pending.push_back(mNodes[i]->mPredecessors);
+        if(0 == mNodes[i]->mPredecessors) {
+            ready.push_back(i);
+        }
+    }
+    for(u32 pos = 0; pos < ready.size(); ++pos) {
+        const core::array<u32>& next = mNodes[ready[pos]]->mSuccessors;
+        for(u32 i = 0; i < next.size(); ++i) {
+            if(0 == --pending[next[i]]) {
+                ready.push_back(next[i]);
+            }
+        }
+    }
+    mValid = (ready.size() == mNodes.size());
+    mChecked = true;
+    return mValid;
+}
+
+
+bool CTaskGraph::isRunning()const {
+    return 0 != AppAtomicFetch((s32*) &mActive);
+}
+
+
+bool CTaskGraph::isCancelled()const {
+    return 0 != AppAtomicFetch((s32*) &mCancelled);
+}
+
+
+bool CTaskGraph::launch(CThreadPool& pool) {
+    if(0 == mNodes.size() || isRunning() || !checkCycle()) {
+        return false;
+    }
+    mPool = &pool;
+    for(u32 i = 0; i < mNodes.size(); ++i) {
+        mNodes[i]->mPending = (s32) mNodes[i]->mPredecessors;
+    }
+    mFinished.reset();
+    AppAtomicFetchSet(0, &mCancelled);
+    AppAtomicFetchSet(1, &mActive);
+    AppAtomicFetchSet((s32) mNodes.size(), &mRemaining);
+
+    //post roots in batches, run the rejected ones here if pool is full or not running.
+    SThreadTask roots[CTaskBatch::EBATCH_SIZE];
+    u32 count = 0;
+    for(u32 i = 0; i < mNodes.size(); ++i) {
+        if(0 == mNodes[i]->mPredecessors) {
+            roots[count++] = SThreadTask(mNodes[i]);
+        }
+        if(count > 0 && (CTaskBatch::EBATCH_SIZE == count || i + 1 == mNodes.size())) {
+            for(u32 pos = pool.addTasks(roots, count); pos < count; ++pos) {
+                roots[pos]();
+            }
+            count = 0;
+        }
+    }
+    return true;
+}
+
+
+void CTaskGraph::runReady(SNode* head) {
+    //the graph may be destroyed once the last node finished, don't touch it after loop.
+    head->mNextReady = 0;
+    while(head) {
+        SNode* node = head;
+        if(0 == AppAtomicFetch(&mCancelled)) {
+            node->mTask();
+        }
+        head = onFinish(*node, node->mNextReady);
+    }
+}
+
+
+CTaskGraph::SNode* CTaskGraph::onFinish(SNode& node, SNode* ready) {
+    for(u32 i = 0; i < node.mSuccessors.size(); ++i) {
+        SNode* next = mNodes[node.mSuccessors[i]];
+        if(0 == AppAtomicDecrementFetch(&next->mPending)) {
+            //a cancelled run finishes the rest here, nothing is posted to pool.
+            if(AppAtomicFetch(&mCancelled) || !mPool->addTask(next)) {
+                next->mNextReady = ready;
+                ready = next;
+            }
+        }
+    }
+    if(0 == AppAtomicDecrementFetch(&mRemaining)) {
+        //ready is empty here, the graph may be destroyed once mActive is cleared.
+        mFinished.set();
+        AppAtomicFetchSet(0, &mActive);
+    }
+    return ready;
+}
+
+
+void CTaskGraph::wait() {
+    //help the pool until it's idle, then sleep.
+    while(AppAtomicFetch(&mRemaining) > 0 && mPool->runOneTask()) {
+    }
+    if(!isRunning()) {
+        return;
+    }
+    mFinished.wait();
+    //the finisher is leaving mFinished.set().
+    while(isRunning()) {
+        CThread::yield();
+    }
+}
+
+}//irr
@@ -0,0 +1,123 @@
+#include "CTaskRing.h"
+#include "HAtomicOperator.h"
+#include <utility>
+
+namespace irr {
+
+CTaskRing::CTaskRing() :
+    mPushPosition(0),
+    mPopPosition(0),
+    mMask(0),
+    mCells(0) {
+}
+
+
+CTaskRing::~CTaskRing() {
+    delete[] mCells;
+}
+
+
+void CTaskRing::init(u32 capacity) {
+    u32 cnt = 2;
+    while(cnt < capacity) {
+        cnt <<= 1;
+    }
+    delete[] mCells;
+    mCells = new SCell[cnt];
+    for(u32 i = 0; i < cnt; ++i) {
+        mCells[i].mSequence = (s32) i;
+    }
+    mMask = cnt - 1;
+    mPushPosition = 0;
+    mPopPosition = 0;
+}
+
+
+bool CTaskRing::push(SThreadTask&& it) {
+    SCell* cell;
+    u32 pos = (u32) AppAtomicFetch(&mPushPosition);
+    for(;;) {
+        cell = mCells + (pos & mMask);
+        s32 diff = (s32) ((u32) AppAtomicFetch(&cell->mSequence) - pos);
+        if(0 == diff) {
+            u32 old = (u32) AppAtomicFetchCompareSet((s32) (pos + 1), (s32) pos, &mPushPosition);
+            if(old == pos) {
+                break;
+            }
+            pos = old;
+        } else if(diff < 0) {
+            return false;//full
+        } else {
+            pos = (u32) AppAtomicFetch(&mPushPosition);
+        }
+    }
+    cell->mTask = std::move(it);
+    //publish the cell to consumers.
+    AppAtomicFetchSet((s32) (pos + 1), &cell->mSequence);
+    return true;
+}
+
+
+u32 CTaskRing::push(const SThreadTask* tasks, u32 count) {
+    u32 pos = (u32) AppAtomicFetch(&mPushPosition);
+    u32 ret;
+    for(;;) {
+        //count the free cells from pos.
+        for(ret = 0; ret < count && ret <= mMask; ++ret) {
+            if((u32) AppAtomicFetch(&mCells[(pos + ret) & mMask].mSequence) != pos + ret) {
+                break;
+            }
+        }
+        if(0 == ret) {
+            if((s32) ((u32) AppAtomicFetch(&mCells[pos & mMask].mSequence) - pos) < 0) {
+                return 0;//full
+            }
+            pos = (u32) AppAtomicFetch(&mPushPosition);
+            continue;
+        }
+        u32 old = (u32) AppAtomicFetchCompareSet((s32) (pos + ret), (s32) pos, &mPushPosition);
+        if(old == pos) {
+            break;
+        }
+        pos = old;
+    }
+    for(u32 i = 0; i < ret; ++i) {
+        SCell* cell = mCells + ((pos + i) & mMask);
+        cell->mTask = tasks[i];
+        AppAtomicFetchSet((s32) (pos + i + 1), &cell->mSequence);
+    }
+    return ret;
+}
+
+
+bool CTaskRing::pop(SThreadTask& it) {
+    SCell* cell;
+    u32 pos = (u32) AppAtomicFetch(&mPopPosition);
+    for(;;) {
+        cell = mCells + (pos & mMask);
+        s32 diff = (s32) ((u32) AppAtomicFetch(&cell->mSequence) - (pos + 1));
+        if(0 == diff) {
+            u32 old = (u32) AppAtomicFetchCompareSet((s32) (pos + 1), (s32) pos, &mPopPosition);
+            if(old == pos) {
+                break;
+            }
+            pos = old;
+        } else if(diff < 0) {
+            return false;//empty
+        } else {
+            pos = (u32) AppAtomicFetch(&mPopPosition);
+        }
+    }
+    it = std::move(cell->mTask);
+    //recycle the cell for producers of next round.
+    AppAtomicFetchSet((s32) (pos + mMask + 1), &cell->mSequence);
+    return true;
+}
+
+
+u32 CTaskRing::size()const {
+    s32 count = (s32) ((u32) AppAtomicFetch((s32*) &mPushPosition) - (u32) AppAtomicFetch((s32*) &mPopPosition));
+    return count > 0 ? (u32) count : 0;
+}
+
+}//irr
@@ -78,41 +78,48 @@ void CThread::setPriority(EThreadPriority iPriority) {
 }
 
 
-void CThread::start(IRunnable& target) {
+bool CThread::start(IRunnable& target) {
     if(isRunning()) {
-        return;  //printf("thread already running");
+        return false;  //printf("thread already running");
     }
     mTask = target;
-    createThread(runnableEntry, this);
+    return createThread(runnableEntry, this);
 }
 
 
-void CThread::start(AppCallable iTarget, void* iData) {
+bool CThread::start(AppCallable iTarget, void* iData) {
     if(isRunning() || 0 == iTarget) {
         //printf("thread already running");
-        return;
+        return false;
     }
     threadCleanup();
     mTask.setTarget(iTarget, iData);
-    createThread(callableEntry, this);
+    return createThread(callableEntry, this);
 }
 
 
-void CThread::createThread(AppThreadEntry ent, void* pData) {
+bool CThread::createThread(AppThreadEntry ent, void* pData) {
+    //bind before running, so the stack is touched on the bound processors.
+    const DWORD flag = mAffinity.size() > 0 ? CREATE_SUSPENDED : 0;
 #if defined(_DLL)
-    mThread = ::CreateThread(NULL, mStackSize, ent, pData, 0, &mThreadID);
+    mThread = ::CreateThread(NULL, mStackSize, ent, pData, flag, &mThreadID);
 #else
     u32 threadId;
-    mThread = (HANDLE) ::_beginthreadex(0, mStackSize, ent, this, 0, &threadId);
+    mThread = (HANDLE) ::_beginthreadex(0, mStackSize, ent, this, flag, &threadId);
     mThreadID = static_cast<DWORD>(threadId);
 #endif
 
     if(!mThread) {
-        return; //printf("cannot create thread");
+        return false; //printf("cannot create thread");
+    }
+    if(flag) {
+        applyAffinity();
+        ::ResumeThread(mThread);
     }
     if(mPriority != PRIO_NORMAL && !::SetThreadPriority(mThread, mPriority)) {
         //printf("cannot set thread priority");
     }
+    return true;
 }
 
 
@@ -167,6 +174,99 @@ void CThread::yield() {
 }
 
 
+s64 CThread::getTickCount() {
+    return (s64) ::GetTickCount64();
+}
+
+
+s64 CThread::getTickNanoseconds() {
+    static LARGE_INTEGER freq = {0};
+    if(0 == freq.QuadPart) {
+        ::QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER cnt;
+    ::QueryPerformanceCounter(&cnt);
+    return (s64) (cnt.QuadPart / freq.QuadPart * 1000000000LL
+        + cnt.QuadPart % freq.QuadPart * 1000000000LL / freq.QuadPart);
+}
+
+
+u32 CThread::getProcessorCount() {
+    return ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+
+u32 CThread::getCurrentProcessor() {
+    PROCESSOR_NUMBER pn;
+    ::GetCurrentProcessorNumberEx(&pn);
+    return pn.Group * 64U + pn.Number;
+}
+
+
+u32 CThread::getNumaNodeCount() {
+    ULONG high = 0;
+    if(!::GetNumaHighestNodeNumber(&high)) {
+        return 1;
+    }
+    return high + 1;
+}
+
+
+///@return Processors of group which the process is allowed to run on.
+static KAFFINITY AppGetAllowedMask(WORD group, KAFFINITY mask) {
+    USHORT primary = 0;
+    USHORT count = 1;
+    DWORD_PTR proc, sys;
+    //a process in multiple groups fails with a small buffer, its mask is unknown.
+    if(::GetProcessGroupAffinity(::GetCurrentProcess(), &count, &primary) && primary == group
+        && ::GetProcessAffinityMask(::GetCurrentProcess(), &proc, &sys)) {
+        return mask & (KAFFINITY) proc;
+    }
+    return mask;
+}
+
+
+bool CThread::getNumaNodeProcessors(u32 node, core::array<u32>& cpus) {
+    GROUP_AFFINITY ga;
+    if(!::GetNumaNodeProcessorMaskEx((USHORT) node, &ga)) {
+        return false;
+    }
+    ga.Mask = AppGetAllowedMask(ga.Group, ga.Mask);
+    cpus.set_used(0);
+    for(u32 i = 0; i < 64; ++i) {
+        if(ga.Mask & ((KAFFINITY) 1 << i)) {
+            cpus.push_back(ga.Group * 64U + i);
+        }
+    }
+    return true;
+}
+
+
+bool CThread::applyAffinity() {
+    if(!mThread) {
+        return false;
+    }
+    GROUP_AFFINITY ga;
+    ::memset(&ga, 0, sizeof(ga));
+    if(0 == mAffinity.size()) {
+        u32 cnt = ::GetActiveProcessorCount(0);
+        ga.Mask = cnt >= 64 ? (KAFFINITY) -1 : (((KAFFINITY) 1 << cnt) - 1);
+    } else {
+        ga.Group = (WORD) (mAffinity[0] / 64);
+        for(u32 i = 0; i < mAffinity.size(); ++i) {
+            if(ga.Group == mAffinity[i] / 64) {
+                ga.Mask |= (KAFFINITY) 1 << (mAffinity[i] % 64);
+            }
+        }
+        ga.Mask = AppGetAllowedMask(ga.Group, ga.Mask);
+        if(0 == ga.Mask) {
+            return false;
+        }
+    }
+    return TRUE == ::SetThreadGroupAffinity((HANDLE) mThread, &ga, 0);
+}
+
+
 void CThread::threadCleanup() {
     if(!mThread) {
         return;
@@ -229,6 +329,55 @@ unsigned __stdcall CThread::callableEntry(void* iThread) {
 
 #elif defined( APP_PLATFORM_ANDROID )  || defined( APP_PLATFORM_LINUX )
 #include <time.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if defined(APP_PLATFORM_LINUX)
+/**
+*@brief Get processors the process is allowed to run on, eg: limited by cgroup or taskset.
+* It's the mask of main thread, so a bound thread which starts another doesn't narrow it.
+*/
+static void AppGetAllowedCpuSet(cpu_set_t& set) {
+    if(0 != ::sched_getaffinity(::getpid(), sizeof(set), &set)) {
+        CPU_ZERO(&set);
+        for(u32 i = 0, cnt = CThread::getProcessorCount(); i < cnt && i < CPU_SETSIZE; ++i) {
+            CPU_SET(i, &set);
+        }
+    }
+}
+
+
+/**
+*@brief Fill set with the allowed processors of cpus.
+*@return false if none is allowed.
+*/
+static bool AppFillCpuSet(const core::array<u32>& cpus, cpu_set_t& set) {
+    cpu_set_t allowed;
+    AppGetAllowedCpuSet(allowed);
+    CPU_ZERO(&set);
+    for(u32 i = 0; i < cpus.size(); ++i) {
+        if(cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed)) {
+            CPU_SET(cpus[i], &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+
+///remove processors the process is not allowed to run on.
+static void AppKeepAllowed(core::array<u32>& cpus) {
+    cpu_set_t allowed;
+    AppGetAllowedCpuSet(allowed);
+    u32 kept = 0;
+    for(u32 i = 0; i < cpus.size(); ++i) {
+        if(cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed)) {
+            cpus[kept++] = cpus[i];
+        }
+    }
+    cpus.set_used(kept);
+}
+#endif
 
 
 CThread::CThread() :
@@ -268,6 +417,103 @@ void CThread::yield() {
     sched_yield();
 }
 
+
+s64 CThread::getTickCount() {
+    struct timespec tm;
+    ::clock_gettime(CLOCK_MONOTONIC, &tm);
+    return (s64) tm.tv_sec * 1000 + tm.tv_nsec / 1000000;
+}
+
+
+s64 CThread::getTickNanoseconds() {
+    struct timespec tm;
+    ::clock_gettime(CLOCK_MONOTONIC, &tm);
+    return (s64) tm.tv_sec * 1000000000LL + tm.tv_nsec;
+}
+
+
+u32 CThread::getProcessorCount() {
+    long ret = ::sysconf(_SC_NPROCESSORS_CONF);
+    return ret > 0 ? (u32) ret : 1;
+}
+
+
+u32 CThread::getCurrentProcessor() {
+    s32 ret = ::sched_getcpu();
+    return ret > 0 ? (u32) ret : 0;
+}
+
+
+u32 CThread::getNumaNodeCount() {
+    c8 path[64];
+    u32 ret = 0;
+    for(; ret < 1024; ++ret) {
+        ::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u", ret);
+        if(0 != ::access(path, F_OK)) {
+            break;
+        }
+    }
+    return ret > 0 ? ret : 1;
+}
+
+
+bool CThread::getNumaNodeProcessors(u32 node, core::array<u32>& cpus) {
+    cpus.set_used(0);
+    c8 path[64];
+    ::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    FILE* fp = ::fopen(path, "r");
+    if(!fp) {
+        if(0 != node) {
+            return false;
+        }
+        //not a NUMA system, all processors are in node 0.
+        for(u32 i = 0, cnt = getProcessorCount(); i < cnt; ++i) {
+            cpus.push_back(i);
+        }
+#if defined(APP_PLATFORM_LINUX)
+        AppKeepAllowed(cpus);
+#endif
+        return true;
+    }
+    //format: 0-3,8,10-11
+    u32 first, last;
+    c8 sep;
+    while(1 == ::fscanf(fp, "%u", &first)) {
+        last = first;
+        if(1 == ::fscanf(fp, "%c", &sep) && '-' == sep) {
+            if(1 != ::fscanf(fp, "%u", &last) || 1 != ::fscanf(fp, "%c", &sep)) {
+                sep = 0;
+            }
+        }
+        for(; first <= last; ++first) {
+            cpus.push_back(first);
+        }
+        if(',' != sep) {
+            break;
+        }
+    }
+    ::fclose(fp);
+#if defined(APP_PLATFORM_LINUX)
+    AppKeepAllowed(cpus);
+#endif
+    return true;
+}
+
+
+bool CThread::applyAffinity() {
+#if defined(APP_PLATFORM_LINUX)
+    cpu_set_t cset;
+    if(0 == mAffinity.size()) {
+        AppGetAllowedCpuSet(cset);
+    } else if(!AppFillCpuSet(mAffinity, cset)) {
+        return false;
+    }
+    return 0 == ::pthread_setaffinity_np(mThreadID, sizeof(cset), &cset);
+#else
+    return false;
+#endif
+}
+
 void CThread::setPriority(EThreadPriority iPriority) {
     if(iPriority != mPriority) {
         mPriority = iPriority;
@@ -292,10 +538,10 @@ s32 CThread::getMaxPriority(s32 iPolicy/* = POLICY_DEFAULT*/) {
 }
 
 
-void CThread::start(IRunnable& target) {
+bool CThread::start(IRunnable& target) {
     if(isRunning()) {
         //printf("thread already running");
-        return;
+        return false;
     }
     pthread_attr_t attributes;
     pthread_attr_init(&attributes);
@@ -307,11 +553,20 @@ void CThread::start(IRunnable& target) {
         }
     }
 
+#if defined(APP_PLATFORM_LINUX)
+    //bind before running, so the stack is touched on the bound processors.
+    cpu_set_t cset;
+    if(mAffinity.size() > 0 && AppFillCpuSet(mAffinity, cset)) {
+        pthread_attr_setaffinity_np(&attributes, sizeof(cset), &cset);
+    }
+#endif
+
     mTask = target;
     if(pthread_create(&mThreadID, &attributes, runnableEntry, this)) {
         mTask.mType = SThreadTask::ETT_NONE;
         pthread_attr_destroy(&attributes);
         //printf("cannot start thread");
+        return false;
     }
     pthread_attr_destroy(&attributes);
 
@@ -330,13 +585,14 @@ void CThread::start(IRunnable& target) {
             //printf("cannot set thread priority");
         }
     }
+    return true;
 }
 
 
-void CThread::start(AppCallable target, void* pData) {
+bool CThread::start(AppCallable target, void* pData) {
     if(isRunning() || 0 == target) {
         //printf("thread already running");
-        return;
+        return false;
     }
     pthread_attr_t attributes;
     pthread_attr_init(&attributes);
@@ -346,11 +602,20 @@ void CThread::start(AppCallable target, void* pData) {
             //printf("can not set thread stack size");
         }
     }
+#if defined(APP_PLATFORM_LINUX)
+    cpu_set_t cset;
+    if(mAffinity.size() > 0 && AppFillCpuSet(mAffinity, cset)) {
+        pthread_attr_setaffinity_np(&attributes, sizeof(cset), &cset);
+    }
+#endif
     mTask.setTarget(target, pData);
     if(pthread_create(&mThreadID, &attributes, callableEntry, this)) {
         mTask.mType = SThreadTask::ETT_NONE;
+        pthread_attr_destroy(&attributes);
         //printf("cannot start thread");
+        return false;
     }
+    pthread_attr_destroy(&attributes);
 
     if(mPolicy == SCHED_OTHER) {
         if(mPriority != PRIO_NORMAL) {
@@ -367,15 +632,21 @@ void CThread::start(AppCallable target, void* pData) {
             //printf("cannot set thread priority");
         }
     }
+    return true;
 }
 
 
 void CThread::join() {
     //mEvent.wait();
+    if(!isRunning()) {
+        return;
+    }
     void* result;
     if(pthread_join(mThreadID, &result)) {
         //printf("cannot join thread"); 
     }
+    //joined, don't detach it in destructor.
+    mTask.mType = SThreadTask::ETT_NONE;
 }
 
 
@@ -523,6 +794,17 @@ void CThread::wakeUp() {
 }
 
 
+bool CThread::setAffinity(const u32* cpus, u32 count) {
+    mAffinity.set_used(0);
+    if(cpus) {
+        for(u32 i = 0; i < count; ++i) {
+            mAffinity.push_back(cpus[i]);
+        }
+    }
+    return isRunning() ? applyAffinity() : true;
+}
+
+
 void CThread::makeName() {
     mName = "#";
     mName.append(core::stringc(mID));
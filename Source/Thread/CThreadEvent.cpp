@@ -156,6 +156,7 @@ bool CThreadEvent::wait() {
         mStatus = false;
     }
     ::pthread_mutex_unlock(&mMutex);
+    return true;
 }
 
 
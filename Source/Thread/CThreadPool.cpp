@@ -1,4 +1,6 @@
 ﻿#include "CThreadPool.h"
+#include "CTaskDeque.h"
+#include "CThreadEvent.h"
 #include "IAppLogger.h"
 #include "HAtomicOperator.h"
 
@@ -8,115 +10,839 @@ static s32 G_ENQUEUE_COUNT = 0;
 static s32 G_DEQUEUE_COUNT = 0;
 #endif
 
-CThreadPool::CThreadPool(u32 iThreadCount) :
-    mWaitingTasks(0),
+
+///local context of a worker.
+struct CThreadPool::SWorker {
+    CTaskDeque mQueue;  ///<only used in ETPM_WORK_STEALING mode
+    const CThreadPool* mPool;
+    u32 mID;
+    u32 mSeed;      ///<seed of victim selection
+    u32 mTick;      ///<position in schedule of priorities
+    bool mRetiring; ///<idle timeout, the thread is quitting
+    bool mRetired;  ///<the thread quit and released mutex, slot can be reused
+    bool mParked;   ///<in idle stack, guarded by mIdleLock
+    u32 mShard;     ///<index of NUMA shard
+    u32 mLane;      ///<home lane of global queues
+    core::array<u32> mCpus; ///<processors to bind, empty if not bound
+    CThreadEvent mWakeup;   ///<parking slot
+    s8 mPadding0[APP_CACHE_LINE_SIZE];
+    SThreadPoolStats mStats;    ///<written by the worker only
+    s8 mPadding1[APP_CACHE_LINE_SIZE];
+
+    SWorker() : mPool(0), mID(0), mSeed(0), mTick(0),
+        mRetiring(false), mRetired(false), mParked(false), mShard(0), mLane(0) {
+        mWakeup.init(0, true);
+    }
+
+    u32 getRandom() {
+        //xorshift32
+        mSeed ^= mSeed << 13;
+        mSeed ^= mSeed >> 17;
+        mSeed ^= mSeed << 5;
+        return mSeed;
+    }
+};
+
+thread_local CThreadPool::SWorker* CThreadPool::mCurrentWorker = 0;
+
+///seed of lane picking of producers which are not workers
+static thread_local u32 G_LANE_SEED = 0;
+
+///post time of task in microseconds, low 32 bits, never 0.
+static u32 AppPostTime(s64 nanoseconds) {
+    u32 ret = (u32) (nanoseconds / 1000);
+    return ret ? ret : 1;
+}
+
+
+///queues of a shard, initialized by a thread bound to the node.
+struct SShardQueues {
+    CTaskRing* mQueue;
+    u32 mCount;
+    u32 mCapacity;
+    core::array<CTaskDeque*> mDeques;   ///<deques of workers on the shard
+};
+
+static void AppInitShardQueues(void* it) {
+    SShardQueues* ctx = (SShardQueues*) it;
+    for(u32 i = 0; i < ctx->mCount; ++i) {
+        ctx->mQueue[i].init(ctx->mCapacity);
+    }
+    for(u32 i = 0; i < ctx->mDeques.size(); ++i) {
+        ctx->mDeques[i]->init(APP_THREADPOOL_DEQUE_SIZE);
+    }
+}
+
+
+CThreadPool::CThreadPool(u32 iThreadCount, EThreadPoolMode iMode/* = ETPM_SHARED_QUEUE*/) :
     mActiveCount(0),
-    mWorker(0),
-    mTaskListTail(0),
-    mThreadCount(iThreadCount),
     mStatus(ESTATUS_STOPED),
-    mMaxTasks(0) {
-    mTaskListTail = &mTaskListHead;
+    mWaitingTasks(0),
+    mIdleCount(0),
+    mSpinCount(128),
+    mStatistics(false),
+    mYieldCount(2),
+    mThreadCount(iThreadCount),
+    mMinThreads(iThreadCount),
+    mWorkerCount(0),
+    mSpawnLatency(10),
+    mIdleTimeout(30000),
+    mBacklogSince(0),
+    mLastSpawn(0),
+    mMaxTasks(0),
+    mMode(iMode),
+    mPlacement(ETPL_NONE),
+    mShardCount(1),
+    mLanes(1),
+    mLaneCount(1),
+    mIdleStack(0),
+    mIdleTop(0),
+    mQueue(0),
+    mSoleCount(0),
+    mScheduleSize(0),
+    mWorker(0),
+    mWorkerQueue(0),
+    mTimerThread(0),
+    mTimerBase(0),
+    mTimerWake(0) {
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        mOverflowTail[i] = &mOverflowHead[i];
+        mOverflowCount[i] = 0;
+    }
+    mWeight[ETP_HIGH] = 16;
+    mWeight[ETP_NORMAL] = 4;
+    mWeight[ETP_LOW] = 1;
+    mTimerEvent.init(0, true);
 }
 
 
 CThreadPool::~CThreadPool() {
     stop();
+    delete[] mQueue;
+}
+
+
+void CThreadPool::buildSchedule() {
+    u32 weight[ETP_COUNT];
+    u32 total = 0;
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        total += mWeight[i];
+    }
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        weight[i] = total > ESCHEDULE_SIZE ? (mWeight[i] * ESCHEDULE_SIZE + total - 1) / total : mWeight[i];
+    }
+    total = 0;
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        total += weight[i];
+    }
+    if(0 == total) {
+        //strict priority
+        mSchedule[0] = ETP_HIGH;
+        mScheduleSize = 1;
+        return;
+    }
+    if(total > ESCHEDULE_SIZE) {
+        //rounded up, take back from the biggest.
+        u32 big = 0;
+        for(u32 i = 1; i < ETP_COUNT; ++i) {
+            big = weight[i] > weight[big] ? i : big;
+        }
+        weight[big] -= total - ESCHEDULE_SIZE;
+        total = ESCHEDULE_SIZE;
+    }
+    //smooth weighted round-robin, so a lower priority is not served in bursts.
+    s32 current[ETP_COUNT] = {0};
+    for(u32 n = 0; n < total; ++n) {
+        u32 pick = 0;
+        for(u32 i = 0; i < ETP_COUNT; ++i) {
+            current[i] += (s32) weight[i];
+            if(current[i] > current[pick]) {
+                pick = i;
+            }
+        }
+        current[pick] -= (s32) total;
+        mSchedule[n] = (u8) pick;
+    }
+    mScheduleSize = total;
+}
+
+
+void CThreadPool::placeWorkers() {
+    mShardCount = 1;
+    mCpuShard.set_used(0);
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        mWorkerQueue[i].mShard = 0;
+        mWorkerQueue[i].mCpus.set_used(0);
+    }
+    if(ETPL_NONE == mPlacement) {
+        return;
+    }
+    core::array<core::array<u32> > nodes;
+    core::array<u32> all; //processors in order of nodes
+    core::array<u32> cpus;
+    for(u32 i = 0, cnt = CThread::getNumaNodeCount(); i < cnt; ++i) {
+        //skip nodes without processors, eg: memory only nodes.
+        if(CThread::getNumaNodeProcessors(i, cpus) && cpus.size() > 0) {
+            nodes.push_back(cpus);
+            for(u32 k = 0; k < cpus.size(); ++k) {
+                all.push_back(cpus[k]);
+            }
+        }
+    }
+    if(0 == nodes.size()) {
+        return;
+    }
+    if(ETPL_NUMA == mPlacement && nodes.size() > 1) {
+        mShardCount = core::min_(nodes.size(), mThreadCount);
+        for(u32 i = 0; i < mShardCount; ++i) {
+            for(u32 k = 0; k < nodes[i].size(); ++k) {
+                while(mCpuShard.size() <= nodes[i][k]) {
+                    mCpuShard.push_back(0);
+                }
+                mCpuShard[nodes[i][k]] = i;
+            }
+        }
+    }
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        SWorker& worker = mWorkerQueue[i];
+        switch(mPlacement) {
+        case ETPL_COMPACT:
+            worker.mCpus.push_back(all[i % all.size()]);
+            break;
+        case ETPL_SCATTER:
+        {
+            const core::array<u32>& node = nodes[i % nodes.size()];
+            worker.mCpus.push_back(node[(i / nodes.size()) % node.size()]);
+            break;
+        }
+        case ETPL_NUMA:
+            worker.mShard = i % mShardCount;
+            worker.mCpus = nodes[i % nodes.size()];
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+void CThreadPool::createQueues() {
+    mLaneCount = (0 == mLanes || mLanes > mThreadCount) ? mThreadCount : mLanes;
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        //spread workers of a shard over lanes.
+        mWorkerQueue[i].mLane = (i / mShardCount) % mLaneCount;
+    }
+    delete[] mQueue;
+    mQueue = new CTaskRing[getQueueCount()];
+    SShardQueues ctx;
+    ctx.mCount = mLaneCount * ETP_COUNT;
+    ctx.mCapacity = mMaxTasks > 0 ? mMaxTasks : APP_THREADPOOL_QUEUE_SIZE;
+    //deques are allocated once, a respawned worker reuses the deque of its slot,
+    //because thieves may be stealing from it.
+    if(1 == mShardCount) {
+        ctx.mQueue = mQueue;
+        for(u32 i = 0; ETPM_WORK_STEALING == mMode && i < mThreadCount; ++i) {
+            ctx.mDeques.push_back(&mWorkerQueue[i].mQueue);
+        }
+        AppInitShardQueues(&ctx);
+        return;
+    }
+    //worker i is on shard i, so the slots are first touched on the node.
+    for(u32 i = 0; i < mShardCount; ++i) {
+        ctx.mQueue = &getQueue(i, 0, 0);
+        ctx.mDeques.set_used(0);
+        for(u32 k = 0; ETPM_WORK_STEALING == mMode && k < mThreadCount; ++k) {
+            if(i == mWorkerQueue[k].mShard) {
+                ctx.mDeques.push_back(&mWorkerQueue[k].mQueue);
+            }
+        }
+        CThread td;
+        td.setAffinity(mWorkerQueue[i].mCpus.const_pointer(), mWorkerQueue[i].mCpus.size());
+        if(td.start(AppInitShardQueues, &ctx)) {
+            td.join();
+        } else {
+            AppInitShardQueues(&ctx);
+        }
+    }
+}
+
+
+u32 CThreadPool::getShard(const SWorker* worker)const {
+    if(worker) {
+        return worker->mShard;
+    }
+    if(mShardCount > 1) {
+        u32 cpu = CThread::getCurrentProcessor();
+        return cpu < mCpuShard.size() ? mCpuShard[cpu] : 0;
+    }
+    return 0;
+}
+
+
+u32 CThreadPool::pickLane(SWorker* current, u32 shard, u32 iPriority)const {
+    if(1 == mLaneCount) {
+        return 0;
+    }
+    u32 rand;
+    if(current) {
+        rand = current->getRandom();
+    } else {
+        u32& seed = G_LANE_SEED;
+        if(0 == seed) {
+            seed = (u32) (size_t) &seed ^ (u32) CThread::getTickCount();
+            seed = (0 == seed ? 2654435761U : seed);
+        }
+        //xorshift32
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        rand = seed;
+    }
+    //power of two choices
+    const u32 first = rand % mLaneCount;
+    const u32 second = (rand >> 16) % mLaneCount;
+    return getQueue(shard, second, iPriority).size() < getQueue(shard, first, iPriority).size() ? second : first;
+}
+
+
+u32 CThreadPool::pushQueue(SWorker* current, const SThreadTask* tasks, u32 count, u32 iPriority) {
+    const u32 shard = getShard(current);
+    u32 ret = 0;
+    //other lanes if the picked one is full.
+    for(u32 i = 0, lane = pickLane(current, shard, iPriority); i < mLaneCount && ret < count; ++i) {
+        CTaskRing& queue = getQueue(shard, lane, iPriority);
+        ret += queue.push(tasks + ret, count - ret);
+        if(++lane == mLaneCount) {
+            lane = 0;
+        }
+    }
+    return ret;
+}
+
+
+bool CThreadPool::pushQueue(SWorker* current, SThreadTask&& it, u32 iPriority) {
+    const u32 shard = getShard(current);
+    for(u32 i = 0, lane = pickLane(current, shard, iPriority); i < mLaneCount; ++i) {
+        if(getQueue(shard, lane, iPriority).push(std::move(it))) {
+            return true;
+        }
+        if(++lane == mLaneCount) {
+            lane = 0;
+        }
+    }
+    return false;
 }
 
 
 void CThreadPool::creatThread(u32 iCount) {
-    mWorker = new CThread*[iCount];
-    ::memset(mWorker, 0, iCount * sizeof(CThread*));
+    buildSchedule();
+    //slots for max workers, only iCount workers are started now.
+    SWorker* slots = new SWorker[mThreadCount];
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        slots[i].mPool = this;
+        slots[i].mID = i;
+        slots[i].mSeed = 2654435761U * (i + 1);
+    }
+    mMutex.lock();
+    mWorkerQueue = slots;
+    mMutex.unlock();
+    placeWorkers();
+    createQueues();
+    mIdleStack = new u32[mThreadCount];
+    mIdleTop = 0;
+    mWorker = new CThread*[mThreadCount];
+    ::memset(mWorker, 0, mThreadCount * sizeof(CThread*));
+    mBacklogSince = 0;
+    CAutoLock ak(mMutex);
+    mWorkerCount = 0;
     for(u32 i = 0; i < iCount; ++i) {
-        mWorker[i] = (new CThread());
-        mWorker[i]->start(*this);
+        if(!spawnWorker()) {
+            //start() waits a count down of every worker.
+            mStartLatch.countDown();
+        }
     }
     //IAppLogger::log(ELOG_INFO, "CThreadPool::creatThread", "created thereads success, total: [%d]",iCount);
 }
 
 
+bool CThreadPool::spawnWorker() {
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        if(mWorker[i] && !mWorkerQueue[i].mRetired) {
+            continue;
+        }
+        if(mWorker[i]) {
+            //the retired thread had released the mutex and is quitting.
+            mWorker[i]->join();
+            delete mWorker[i];
+        }
+        mWorkerQueue[i].mRetiring = false;
+        mWorkerQueue[i].mRetired = false;
+        mWorker[i] = new CThread();
+        mWorker[i]->setAffinity(mWorkerQueue[i].mCpus.const_pointer(), mWorkerQueue[i].mCpus.size());
+        if(!mWorker[i]->start(*this)) {
+            delete mWorker[i];
+            mWorker[i] = 0;
+            IAppLogger::log(ELOG_ERROR, "CThreadPool::spawnWorker", "failed to start worker: %u", i);
+            return false;
+        }
+        mWorkerCount = mWorkerCount + 1;
+        return true;
+    }
+    return false;
+}
+
+
+void CThreadPool::checkSpawn() {
+    if(mWorkerCount >= mThreadCount || ESTATUS_RUNNIG != mStatus) {
+        return;
+    }
+    s32 now = (s32) CThread::getTickCount();
+    now = (0 == now ? 1 : now);
+    s32 since = AppAtomicFetch(&mBacklogSince);
+    if(0 == since) {
+        AppAtomicFetchCompareSet(now, 0, &mBacklogSince);
+        return;
+    }
+    if((u32) (now - since) < mSpawnLatency) {
+        return;
+    }
+    CAutoLock ak(mMutex);
+    if(mWorkerCount >= mThreadCount || ESTATUS_RUNNIG != mStatus) {
+        return;
+    }
+    //hysteresis: one spawn per latency period, give the new worker time to drain.
+    if((u32) (now - mLastSpawn) < mSpawnLatency) {
+        return;
+    }
+    mLastSpawn = now;
+    AppAtomicFetchSet(now, &mBacklogSince);
+    if(spawnWorker()) {
+        IAppLogger::log(ELOG_INFO, "CThreadPool::checkSpawn", "workers: %u/%u", mWorkerCount, mThreadCount);
+    }
+}
+
+
 void CThreadPool::removeAll() {
     for(u32 i = 0; i < mThreadCount; ++i) {
-        mWorker[i]->join();
-        delete mWorker[i];
-        //mWorker[i] = 0;
+        if(mWorker[i]) {
+            mWorker[i]->join();
+            delete mWorker[i];
+        }
+    }
+#if defined(APP_DEBUG)
+    if(ESTATUS_JOINING == mStatus) {
+        APP_ASSERT(G_ENQUEUE_COUNT == G_DEQUEUE_COUNT);
     }
-    delete mWorker;
+#endif
+    mWorkerCount = 0;
+    delete[] mWorker;
     mWorker = 0;
+    SThreadTask task;
+    s32 dropped = 0;
+    if(ETPM_WORK_STEALING == mMode) {
+        //threads are joined, so pop the dropped tasks here.
+        for(u32 i = 0; i < mThreadCount; ++i) {
+            while(mWorkerQueue[i].mQueue.pop(task)) {
+                task.discard();
+                ++dropped;
+            }
+        }
+    }
+    mMutex.lock();
+    //keep stats of the freed workers for getStats().
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        mStoppedStats.merge(mWorkerQueue[i].mStats);
+    }
+    delete[] mWorkerQueue;
+    mWorkerQueue = 0;
+    mMutex.unlock();
+    delete[] mIdleStack;
+    mIdleStack = 0;
+    mIdleTop = 0;
+    mIdleCount = 0;
 
-    SThreadTask* nd;
-    while(mTaskListHead.mNext) {
-        nd = mTaskListHead.mNext;
-        mTaskListHead.mNext = mTaskListHead.mNext->mNext;
-        delete nd;
-        --mWaitingTasks;
+    for(u32 i = 0; i < getQueueCount(); ++i) {
+        while(mQueue[i].pop(task)) {
+            task.discard();
+            ++dropped;
+        }
+    }
+    STaskNode* nd;
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        while(mOverflowHead[i].mNext) {
+            nd = mOverflowHead[i].mNext;
+            mOverflowHead[i].mNext = nd->mNext;
+            nd->mTask.discard();
+            delete nd;
+            ++dropped;
+            mWaitingTasks = mWaitingTasks - 1;
+        }
+        mOverflowTail[i] = &mOverflowHead[i];
+        mOverflowCount[i] = 0;
+    }
+    mWaitingTasks = mWaitingTasks - mSoleCount;
+    if(mSoleCount > 0) {
+        mSoleTask.discard();
+        dropped += mSoleCount;
+    }
+    mSoleCount = 0;
+    if(dropped > 0) {
+        IAppLogger::log(ELOG_INFO, "CThreadPool::removeAll", "dropped tasks: %d", dropped);
+#if defined(APP_DEBUG)
+        //dropped tasks are dequeued, so the pool can be started and joined again.
+        AppAtomicFetchAdd(dropped, &G_DEQUEUE_COUNT);
+#endif
     }
-    mTaskListHead.mNext = 0;
-    mTaskListTail = &mTaskListHead;
     APP_ASSERT(0 == mWaitingTasks);
 }
 
 
+CThreadPool::SWorker* CThreadPool::getCurrentWorker()const {
+    SWorker* worker = mCurrentWorker;
+    return (worker && this == worker->mPool) ? worker : 0;
+}
+
+
+u32 CThreadPool::getWaitingTasks()const {
+    u32 ret = mWaitingTasks;
+    for(u32 i = 0; mQueue && i < getQueueCount(); ++i) {
+        ret += mQueue[i].size();
+    }
+    if(ETPM_WORK_STEALING == mMode && mWorkerQueue) {
+        for(u32 i = 0; i < mThreadCount; ++i) {
+            ret += mWorkerQueue[i].mQueue.size();
+        }
+    }
+    return ret;
+}
+
+
+u32 CThreadPool::getWaitingTasks(ETaskPriority iPriority)const {
+    if(iPriority >= ETP_COUNT) {
+        return 0;
+    }
+    u32 ret = mOverflowCount[iPriority];
+    for(u32 i = 0; mQueue && i < mShardCount; ++i) {
+        for(u32 k = 0; k < mLaneCount; ++k) {
+            ret += getQueue(i, k, iPriority).size();
+        }
+    }
+    if(ETP_NORMAL == iPriority && ETPM_WORK_STEALING == mMode && mWorkerQueue) {
+        for(u32 i = 0; i < mThreadCount; ++i) {
+            ret += mWorkerQueue[i].mQueue.size();
+        }
+    }
+    return ret;
+}
+
+
 void CThreadPool::run() {
+    SWorker* worker = 0;
     mMutex.lock();
-    ++mActiveCount;
-    IAppLogger::log(ELOG_CRITICAL, "CThreadPool::run", "thread start: %u", CThread::getCurrentThread()->getID());
+    CThread* td = CThread::getCurrentThread();
+    for(u32 i = 0; i < mThreadCount; ++i) {
+        if(td == mWorker[i]) {
+            worker = mWorkerQueue + i;
+            break;
+        }
+    }
+    mActiveCount = mActiveCount + 1;
+    IAppLogger::log(ELOG_CRITICAL, "CThreadPool::run", "thread start: %u", td->getID());
     mMutex.unlock();
+    mStartLatch.countDown();
 
-    SThreadTask* iTask = 0;
-    bool deleteTask = true;
+    APP_ASSERT(worker);
+    mCurrentWorker = worker;
+    SThreadTask iTask;
+    SThreadPoolStats& stats = worker->mStats;
+    s64 idleSince = 0;
 
+    const bool elastic = isElastic();
     while(ESTATUS_STOPED != mStatus) {
-        mMutex.lock();
-        while(ESTATUS_STOPED != mStatus) {//@note: avoid spurious wakeup in a loop.
-            if(mTaskListHead.mNext) {
-                iTask = mTaskListHead.mNext;
-                mTaskListHead.mNext = mTaskListHead.mNext->mNext;
-                if(0 == mTaskListHead.mNext) {
-                    APP_ASSERT(1 == mWaitingTasks);
-                    APP_ASSERT(mTaskListTail == iTask);
-                    mTaskListTail = &mTaskListHead;
-                }
-                if(--mWaitingTasks > 0) {
-                    mCondition.notify();
-                }
-                break;
-            } 
-            if(mTaskListHead.mCount > 0) {
-                iTask = &mTaskListHead;
-                --mTaskListHead.mCount;
-                deleteTask = false;
-                if(--mWaitingTasks > 0) {
-                    mCondition.notify();
-                }
-                break;
+        if(!popTask(worker, iTask)) {
+            if(mStatistics && 0 == idleSince) {
+                idleSince = CThread::getTickNanoseconds();
             }
-            //mutex is unlocked when waiting and will be locked when awaked.
-            mCondition.wait(mMutex);
-            if(ESTATUS_JOINING == mStatus && 0 == mWaitingTasks) {
-                mStatus = ESTATUS_STOPED;//finished all tasks then exit
+            if(!spinTask(worker, iTask)) {
+                if(!waitTask(*worker)) {
+                    break;
+                }
+                continue;
             }
-        }//while
-        mMutex.unlock();
-
-        if(iTask) {
+        }
 #if defined(APP_DEBUG)
-            AppAtomicIncrementFetch(&G_DEQUEUE_COUNT);
+        AppAtomicIncrementFetch(&G_DEQUEUE_COUNT);
 #endif
-            (*iTask)(); //executed task
-            if(deleteTask) {
-                delete iTask;
+        if(elastic && 0 != AppAtomicFetch(&mBacklogSince) && !hasTask()) {
+            AppAtomicFetchSet(0, &mBacklogSince);
+        }
+        AppCounterAdd(&stats.mTasks, (u64) 1);
+        if(0 == (stats.mTasks & 255)) {
+            sampleDepth(*worker);
+        }
+        if(!mStatistics) {
+            iTask(); //executed task
+            continue;
+        }
+        const s64 start = CThread::getTickNanoseconds();
+        if(idleSince > 0) {
+            AppCounterAdd(&stats.mIdleTime, (u64) (start - idleSince));
+            idleSince = 0;
+        }
+        if(iTask.mPostTime > 0) {
+            const s32 wait = (s32) (AppPostTime(start) - iTask.mPostTime);
+            if(wait > 0) {
+                stats.mWaitTime.add((s64) wait * 1000);
             }
-            deleteTask = true;
-            iTask = 0;
         }
-    }//for
+        iTask(); //executed task
+        const s64 cost = CThread::getTickNanoseconds() - start;
+        AppCounterAdd(&stats.mBusyTime, (u64) cost);
+        stats.mRunTime.add(cost);
+    }//while
 
+    mCurrentWorker = 0;
     mMutex.lock();
-    --mActiveCount;
+    mActiveCount = mActiveCount - 1;
+    if(worker->mRetiring) {
+        worker->mRetired = true;
+        IAppLogger::log(ELOG_INFO, "CThreadPool::run", "worker retired: %u/%u", mWorkerCount, mThreadCount);
+    }
     mMutex.unlock();
-    IAppLogger::log(ELOG_CRITICAL, "CThreadPool::run", "thread quit: %u", CThread::getCurrentThread()->getID());
+    IAppLogger::log(ELOG_CRITICAL, "CThreadPool::run", "thread quit: %u", td->getID());
+}
+
+
+bool CThreadPool::popTask(SWorker* worker, u32 iPriority, SThreadTask& iTask) {
+    const bool local = (ETP_NORMAL == iPriority && worker && ETPM_WORK_STEALING == mMode);
+    if(local && worker->mQueue.pop(iTask)) {
+        return true;
+    }
+    //queues of local shard first, home lane first
+    const u32 home = worker ? worker->mLane : 0;
+    for(u32 i = 0, shard = getShard(worker); i < mShardCount; ++i) {
+        for(u32 k = 0, lane = home; k < mLaneCount; ++k) {
+            if(getQueue(shard, lane, iPriority).pop(iTask)) {
+                return true;
+            }
+            if(++lane == mLaneCount) {
+                lane = 0;
+            }
+        }
+        if(++shard == mShardCount) {
+            shard = 0;
+        }
+    }
+    return local && stealTask(*worker, iTask);
+}
+
+
+bool CThreadPool::popTask(SWorker* worker, SThreadTask& iTask) {
+    //the scheduled priority first, then the others in order of priority.
+    u32 first = ETP_HIGH;
+    if(worker && mScheduleSize > 1) {
+        first = mSchedule[worker->mTick++ % mScheduleSize];
+    }
+    if(popTask(worker, first, iTask)) {
+        return true;
+    }
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        if(i != first && popTask(worker, i, iTask)) {
+            return true;
+        }
+    }
+    if(mWaitingTasks > 0) {
+        CAutoLock ak(mMutex);
+        return popOverflow(iTask);
+    }
+    return false;
+}
+
+
+bool CThreadPool::runOneTask() {
+    if(ESTATUS_STOPED == mStatus) {
+        return false;
+    }
+    SThreadTask iTask;
+    if(!popTask(getCurrentWorker(), iTask)) {
+        return false;
+    }
+#if defined(APP_DEBUG)
+    AppAtomicIncrementFetch(&G_DEQUEUE_COUNT);
+#endif
+    iTask();
+    return true;
+}
+
+
+bool CThreadPool::popOverflow(SThreadTask& iTask) {
+    for(u32 i = 0; i < ETP_COUNT; ++i) {
+        STaskNode* nd = mOverflowHead[i].mNext;
+        if(nd) {
+            mOverflowHead[i].mNext = nd->mNext;
+            if(0 == nd->mNext) {
+                APP_ASSERT(mOverflowTail[i] == nd);
+                mOverflowTail[i] = &mOverflowHead[i];
+            }
+            --mOverflowCount[i];
+            mWaitingTasks = mWaitingTasks - 1;
+            iTask = std::move(nd->mTask);
+            delete nd;
+            return true;
+        }
+    }
+    if(mSoleCount > 0) {
+        --mSoleCount;
+        mWaitingTasks = mWaitingTasks - 1;
+        iTask = mSoleTask;
+        return true;
+    }
+    return false;
+}
+
+
+bool CThreadPool::stealTask(SWorker& worker, SThreadTask& iTask) {
+    if(mThreadCount < 2) {
+        return false;
+    }
+    const u32 start = worker.getRandom() % mThreadCount;
+    //victims of the same shard in first pass.
+    for(u32 pass = (mShardCount > 1 ? 0 : 1); pass < 2; ++pass) {
+        for(u32 i = 0, victim = start; i < mThreadCount; ++i, victim = (start + i) % mThreadCount) {
+            if(victim != worker.mID && (pass || worker.mShard == mWorkerQueue[victim].mShard)
+                && mWorkerQueue[victim].mQueue.steal(iTask)) {
+                AppCounterAdd(&worker.mStats.mSteals, (u64) 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+bool CThreadPool::hasTask()const {
+    if(mWaitingTasks > 0) {
+        return true;
+    }
+    for(u32 i = 0; i < getQueueCount(); ++i) {
+        if(mQueue[i].size() > 0) {
+            return true;
+        }
+    }
+    if(ETPM_WORK_STEALING == mMode) {
+        for(u32 i = 0; i < mThreadCount; ++i) {
+            if(mWorkerQueue[i].mQueue.size() > 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+bool CThreadPool::spinTask(SWorker* worker, SThreadTask& iTask) {
+    static const bool multicore = CThread::getProcessorCount() > 1;
+    //only read when polling, so the spinning workers don't bounce cache lines of queues.
+    for(u32 i = (multicore ? 0 : mSpinCount); i < mSpinCount; ++i) {
+        AppCpuRelax();
+        if(ESTATUS_RUNNIG != mStatus) {
+            return false;
+        }
+        if(hasTask() && popTask(worker, iTask)) {
+            return true;
+        }
+    }
+    for(u32 i = 0; i < mYieldCount; ++i) {
+        CThread::yield();
+        if(ESTATUS_RUNNIG != mStatus) {
+            return false;
+        }
+        if(hasTask() && popTask(worker, iTask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool CThreadPool::waitTask(SWorker& worker) {
+    {
+        CAutoSpinlock ak(mIdleLock);
+        mIdleStack[mIdleTop++] = worker.mID;
+        worker.mParked = true;
+        AppAtomicIncrementFetch(&mIdleCount);
+    }
+    //@note: producers read mIdleCount after pushed, so recheck all queues after registered.
+    bool timeout = false;
+    if(!hasTask() && ESTATUS_RUNNIG == mStatus) {
+        AppAtomicFetchSet(0, &mBacklogSince);
+        AppCounterAdd(&worker.mStats.mParks, (u64) 1);
+        const s64 start = mStatistics ? CThread::getTickNanoseconds() : 0;
+        if(isElastic()) {
+            timeout = !worker.mWakeup.wait(mIdleTimeout);
+        } else {
+            worker.mWakeup.wait();
+        }
+        if(start > 0) {
+            AppCounterAdd(&worker.mStats.mParkTime, (u64) (CThread::getTickNanoseconds() - start));
+        }
+        if(!timeout) {
+            AppCounterAdd(&worker.mStats.mWakeups, (u64) 1);
+            sampleDepth(worker);
+        }
+    }
+    {
+        //leave the idle stack if not popped by a waker.
+        CAutoSpinlock ak(mIdleLock);
+        if(worker.mParked) {
+            worker.mParked = false;
+            u32 i = mIdleTop - 1;
+            while(mIdleStack[i] != worker.mID) {
+                --i;
+            }
+            for(--mIdleTop; i < mIdleTop; ++i) {
+                mIdleStack[i] = mIdleStack[i + 1];
+            }
+            AppAtomicDecrementFetch(&mIdleCount);
+        } else {
+            timeout = false;
+        }
+    }
+    if(ESTATUS_RUNNIG != mStatus) {
+        return hasTask();//joining or stopped, quit if no more tasks.
+    }
+    if(timeout) {
+        CAutoLock ak(mMutex);
+        if(mWorkerCount > mMinThreads && ESTATUS_RUNNIG == mStatus && !hasTask()) {
+            //idle timeout, retire.
+            worker.mRetiring = true;
+            mWorkerCount = mWorkerCount - 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void CThreadPool::wakeIdle(u32 count/* = 1*/) {
+    if(AppAtomicFetch(&mIdleCount) > 0) {
+        //wake the most recently parked worker, its cache is still warm.
+        for(; count > 0; --count) {
+            SWorker* worker = 0;
+            {
+                CAutoSpinlock ak(mIdleLock);
+                if(0 == mIdleTop) {
+                    break;
+                }
+                worker = mWorkerQueue + mIdleStack[--mIdleTop];
+                worker->mParked = false;
+                AppAtomicDecrementFetch(&mIdleCount);
+            }
+            worker->mWakeup.set();
+        }
+    } else if(isElastic()) {
+        checkSpawn();
+    }
 }
 
 
@@ -128,13 +854,14 @@ void CThreadPool::start() {
 
     mMutex.lock();
     mActiveCount = 0;
+    mStoppedStats.clear();
     mMutex.unlock();
-    creatThread(mThreadCount);
-    while(mActiveCount < mThreadCount) {
-        IAppLogger::log(ELOG_CRITICAL, "CThreadPool::start",
-            "waiting all threads start: %u/%u", mActiveCount, mThreadCount);
-        CThread::sleep(10);
-    }
+    const u32 count = getMinThreads();
+    mTimerBase = CThread::getTickCount();
+    mStartLatch.reset(count);
+    creatThread(count);
+    //every started worker counts down once.
+    mStartLatch.wait();
 }
 
 
@@ -143,13 +870,13 @@ void CThreadPool::stop() {
         return;
     }
     mStatus = ESTATUS_STOPED;
+    //workers recheck status after parked, see waitTask().
+    AppAtomicReadWriteBarrier();
     IAppLogger::log(ELOG_CRITICAL, "CThreadPool::stop",
         "[active=%u],[threads=%u],[tasks=%u]",
-        mActiveCount, mThreadCount, mWaitingTasks);
-    while(mActiveCount > 0) {
-        mCondition.notifyAll();
-        CThread::sleep(20);
-    }
+        mActiveCount, mThreadCount, getWaitingTasks());
+    stopTimer();
+    wakeIdle(mThreadCount);
     removeAll();
     IAppLogger::log(ELOG_CRITICAL, "CThreadPool::stop",
         "threads[%u], tasks[%u]",
@@ -162,14 +889,12 @@ void CThreadPool::join() {
         return;
     }
     mStatus = ESTATUS_JOINING;
+    AppAtomicReadWriteBarrier();
     IAppLogger::log(ELOG_CRITICAL, "CThreadPool::join",
         "[active=%u],[threads=%u],[tasks=%u]",
-        mActiveCount, mThreadCount, mWaitingTasks);
-    while(mActiveCount > 0) {
-        mCondition.notify();
-        CThread::sleep(20);
-    }
-    APP_ASSERT(G_ENQUEUE_COUNT == G_DEQUEUE_COUNT);
+        mActiveCount, mThreadCount, getWaitingTasks());
+    stopTimer();
+    wakeIdle(mThreadCount);
     removeAll();
     IAppLogger::log(ELOG_CRITICAL, "CThreadPool::join",
         "threads[%u], tasks[%u]",
@@ -177,39 +902,98 @@ void CThreadPool::join() {
 }
 
 
-bool CThreadPool::addTask(AppCallable iFunc, void* iData/* = 0*/) {
-    if(!iFunc || ESTATUS_RUNNIG != mStatus) {
+bool CThreadPool::postTask(SThreadTask&& it, ETaskPriority iPriority) {
+    if(ESTATUS_RUNNIG != mStatus || iPriority >= ETP_COUNT) {
         return false;
     }
-    bool ret = false;
-    CAutoLock ak(mMutex);
+    if(mStatistics && 0 == it.mPostTime) {
+        it.mPostTime = AppPostTime(CThread::getTickNanoseconds());
+    }
+    SWorker* current = getCurrentWorker();
+    SWorker* worker = (ETPM_WORK_STEALING == mMode && ETP_NORMAL == iPriority ? current : 0);
+    if((worker && worker->mQueue.push(std::move(it))) || pushQueue(current, std::move(it), iPriority)) {
+#if defined(APP_DEBUG)
+        AppAtomicIncrementFetch(&G_ENQUEUE_COUNT);
+#endif
+        wakeIdle();
+        return true;
+    }
+    if(mMaxTasks > 0) {
+        it.mPostTime = 0;
+        return false;//full
+    }
 
-    if(0 == mMaxTasks || mWaitingTasks < mMaxTasks) {
-        ret = true;
-        mTaskListTail->mNext = new SThreadTask(iFunc, iData);
-        mTaskListTail = mTaskListTail->mNext;
-        ++mWaitingTasks;
-        mCondition.notify();
+    {
+        CAutoLock ak(mMutex);
+        mOverflowTail[iPriority]->mNext = new STaskNode(std::move(it));
+        mOverflowTail[iPriority] = mOverflowTail[iPriority]->mNext;
+        ++mOverflowCount[iPriority];
+        mWaitingTasks = mWaitingTasks + 1;
     }
+#if defined(APP_DEBUG)
+    AppAtomicIncrementFetch(&G_ENQUEUE_COUNT);
+#endif
+    wakeIdle();
+    return true;
+}
+
+
+u32 CThreadPool::addTasks(const SThreadTask* tasks, u32 count, ETaskPriority iPriority/* = ETP_NORMAL*/) {
+    if(!tasks || 0 == count || ESTATUS_RUNNIG != mStatus || iPriority >= ETP_COUNT) {
+        return 0;
+    }
+    u32 ret = 0;
+    SWorker* current = getCurrentWorker();
+    SWorker* worker = (ETPM_WORK_STEALING == mMode && ETP_NORMAL == iPriority ? current : 0);
+    if(worker) {
+        for(; ret < count && worker->mQueue.push(SThreadTask(tasks[ret])); ++ret) {
+        }
+    }
+    if(ret < count) {
+        ret += pushQueue(current, tasks + ret, count - ret, iPriority);
+    }
+    if(ret < count && 0 == mMaxTasks) {
+        //link the rest as a chain, under one lock.
+        STaskNode* head = new STaskNode(tasks[ret]);
+        STaskNode* tail = head;
+        for(u32 i = ret + 1; i < count; ++i) {
+            tail->mNext = new STaskNode(tasks[i]);
+            tail = tail->mNext;
+        }
+        CAutoLock ak(mMutex);
+        mOverflowTail[iPriority]->mNext = head;
+        mOverflowTail[iPriority] = tail;
+        mOverflowCount[iPriority] += count - ret;
+        mWaitingTasks = mWaitingTasks + (count - ret);
+        ret = count;
+    }
+#if defined(APP_DEBUG)
+    AppAtomicFetchAdd((s32) ret, &G_ENQUEUE_COUNT);
+#endif
+    wakeIdle(ret);
     return ret;
 }
 
 
-bool CThreadPool::addTask(IRunnable* it) {
-    if(!it || ESTATUS_RUNNIG != mStatus) {
+bool CThreadPool::addTask(AppCallable iFunc, void* iData/* = 0*/, ETaskPriority iPriority/* = ETP_NORMAL*/) {
+    if(!iFunc) {
         return false;
     }
-    bool ret = false;
-    CAutoLock ak(mMutex);
+    return postTask(SThreadTask(iFunc, iData), iPriority);
+}
+
 
-    if(0 == mMaxTasks || mWaitingTasks < mMaxTasks) {
-        ret = true;
-        mTaskListTail->mNext = new SThreadTask(it);
-        mTaskListTail = mTaskListTail->mNext;
-        ++mWaitingTasks;
-        mCondition.notify();
+bool CThreadPool::addTask(IRunnable* it, ETaskPriority iPriority/* = ETP_NORMAL*/) {
+    if(!it) {
+        return false;
     }
-    return ret;
+    return postTask(SThreadTask(it), iPriority);
+}
+
+
+bool CThreadPool::addTask(CTask&& it, ETaskPriority iPriority) {
+    //moved to queue if posted, or left in the task.
+    return it.isValid() && postTask(std::move(it.getTask()), iPriority);
 }
 
 
@@ -217,21 +1001,22 @@ bool CThreadPool::addSoleTask(AppCallable iFunc, void* iData/* = 0*/) {
     if(!iFunc || ESTATUS_RUNNIG != mStatus) {
         return false;
     }
-    CAutoLock ak(mMutex);
-
-    if(0 == mTaskListHead.mCount) {//init task
-        mTaskListHead.setTarget(iFunc, iData);
-    } else if(iFunc == mTaskListHead.mTarget.mCallFunction.mCallback) {
-        ++mTaskListHead.mCount;
-    } else {
-        return false;
+    {
+        CAutoLock ak(mMutex);
+        if(0 == mSoleCount) {//init task
+            mSoleTask.setTarget(iFunc, iData);
+            mSoleCount = 1;
+        } else if(iFunc == mSoleTask.mTarget.mCallFunction.mCallback) {
+            ++mSoleCount;
+        } else {
+            return false;
+        }
+        mWaitingTasks = mWaitingTasks + 1;
     }
-
 #if defined(APP_DEBUG)
     AppAtomicIncrementFetch(&G_ENQUEUE_COUNT);
 #endif
-    ++mWaitingTasks;
-    mCondition.notify();
+    wakeIdle();
     return true;
 }
 
@@ -240,19 +1025,178 @@ bool CThreadPool::addSoleTask(IRunnable* it) {
     if(!it || ESTATUS_RUNNIG != mStatus) {
         return false;
     }
-    CAutoLock ak(mMutex);
+    {
+        CAutoLock ak(mMutex);
+        if(0 == mSoleCount) {//init task
+            mSoleTask = *it;
+            mSoleCount = 1;
+        } else if(it == mSoleTask.mTarget.mCaller) {
+            ++mSoleCount;
+        } else {
+            return false;
+        }
+        mWaitingTasks = mWaitingTasks + 1;
+    }
+#if defined(APP_DEBUG)
+    AppAtomicIncrementFetch(&G_ENQUEUE_COUNT);
+#endif
+    wakeIdle();
+    return true;
+}
 
-    if(0 == mTaskListHead.mCount) {//init task
-        mTaskListHead = it;
-    } else if(it == mTaskListHead.mTarget.mCaller) {
-        ++mTaskListHead.mCount;
-    } else {
-        return false;
+
+
+u64 CThreadPool::addDelayedTask(AppCallable iFunc, void* iData, u32 delay, ETaskPriority iPriority) {
+    if(!iFunc) {
+        return 0;
     }
+    return addTimer(SThreadTask(iFunc, iData), delay, 0, iPriority);
+}
 
-    ++mWaitingTasks;
-    mCondition.notify();
-    return true;
+
+u64 CThreadPool::addDelayedTask(IRunnable* it, u32 delay, ETaskPriority iPriority) {
+    if(!it) {
+        return 0;
+    }
+    return addTimer(SThreadTask(it), delay, 0, iPriority);
+}
+
+
+u64 CThreadPool::addPeriodicTask(AppCallable iFunc, void* iData, u32 period, ETaskPriority iPriority) {
+    if(!iFunc) {
+        return 0;
+    }
+    period = period > 0 ? period : 1;
+    return addTimer(SThreadTask(iFunc, iData), period, period, iPriority);
+}
+
+
+u64 CThreadPool::addPeriodicTask(IRunnable* it, u32 period, ETaskPriority iPriority) {
+    if(!it) {
+        return 0;
+    }
+    period = period > 0 ? period : 1;
+    return addTimer(SThreadTask(it), period, period, iPriority);
+}
+
+
+u64 CThreadPool::addTimer(const SThreadTask& it, u32 delay, u32 period, ETaskPriority iPriority) {
+    const u32 maxDelay = 1U << 30;
+    if(iPriority >= ETP_COUNT) {
+        return 0;
+    }
+    delay = delay < maxDelay ? delay : maxDelay;
+    period = period < maxDelay ? period : maxDelay;
+    bool wake = false;
+    u64 ret;
+    {
+        CAutoLock ak(mTimerMutex);
+        if(ESTATUS_RUNNIG != mStatus) {
+            return 0;
+        }
+        const u32 now = getTimerTick();
+        if(!mTimerThread) {
+            mTimerWake = now + maxDelay;
+            mTimerThread = new CThread();
+            mTimerThread->start(CThreadPool::runTimer, this);
+        }
+        if(0 == mTimers.size()) {
+            //the wheel is not updated while empty, catch up with now.
+            core::array<CTimerWheel::STimerTask> none;
+            mTimers.update(now, none);
+        }
+        ret = mTimers.add(it, now + delay, period, iPriority);
+        if((s32) (now + delay - mTimerWake) < 0) {
+            mTimerWake = now + delay;
+            wake = true;
+        }
+    }
+    if(wake) {
+        mTimerEvent.set();
+    }
+    return ret;
+}
+
+
+bool CThreadPool::cancelTimer(u64 id) {
+    CAutoLock ak(mTimerMutex);
+    return mTimers.cancel(id);
+}
+
+
+void CThreadPool::runTimer(void* it) {
+    CThreadPool& pool = *(CThreadPool*) it;
+    core::array<CTimerWheel::STimerTask> fired;
+    pool.mTimerMutex.lock();
+    while(ESTATUS_RUNNIG == pool.mStatus) {
+        pool.mTimers.update(pool.getTimerTick(), fired);
+        const u32 idle = pool.mTimers.getIdleTicks();
+        pool.mTimerWake = pool.mTimers.getTick() + (idle < (1U << 30) ? idle : (1U << 30));
+        const u32 wake = pool.mTimerWake;
+        pool.mTimerMutex.unlock();
+
+        for(u32 i = 0; i < fired.size(); ++i) {
+            //rejected by a full or stopping pool, a periodic task is skipped to its next period.
+            if(!pool.postTask(std::move(fired[i].mTask), (ETaskPriority) fired[i].mPriority) && 0 == fired[i].mPeriod) {
+                fired[i].mTask.discard();
+            }
+        }
+        fired.set_used(0);
+        s32 wait = (s32) (wake - pool.getTimerTick());
+        if(0xFFFFFFFFU == idle) {
+            pool.mTimerEvent.wait();
+        } else if(wait > 0) {
+            pool.mTimerEvent.wait(wait);
+        }
+        pool.mTimerMutex.lock();
+    }
+    pool.mTimerMutex.unlock();
+}
+
+
+void CThreadPool::stopTimer() {
+    CThread* timer;
+    {
+        CAutoLock ak(mTimerMutex);
+        timer = mTimerThread;
+        mTimerThread = 0;
+    }
+    if(!timer) {
+        return;
+    }
+    mTimerEvent.set();
+    timer->join();
+    delete timer;
+    if(mTimers.size() > 0) {
+        IAppLogger::log(ELOG_INFO, "CThreadPool::stopTimer", "dropped timers: %u", mTimers.size());
+    }
+    mTimers.clear();
+}
+
+
+
+void CThreadPool::sampleDepth(SWorker& worker) {
+    const u32 depth = getWaitingTasks();
+    if(depth > worker.mStats.mMaxDepth) {
+        AppAtomicStoreRelaxed(depth, &worker.mStats.mMaxDepth);
+    }
+}
+
+
+void CThreadPool::getStats(SThreadPoolStats& total, core::array<SThreadPoolStats>* perWorker)const {
+    total.clear();
+    SThreadPoolStats one;
+    CAutoLock ak(const_cast<CMutex&>(mMutex));
+    total.merge(mStoppedStats);
+    for(u32 i = 0; mWorkerQueue && i < mThreadCount; ++i) {
+        //copied by relaxed loads, the worker is writing it.
+        one.clear();
+        one.merge(mWorkerQueue[i].mStats);
+        total.merge(one);
+        if(perWorker) {
+            perWorker->push_back(one);
+        }
+    }
 }
 
 }//irr
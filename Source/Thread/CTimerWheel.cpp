@@ -0,0 +1,207 @@
+#include "CTimerWheel.h"
+
+namespace irr {
+
+CTimerWheel::CTimerWheel() :
+    mTick(0),
+    mCount(0),
+    mRootCount(0),
+    mFree(0) {
+    for(u32 i = 0; i < ESLOT_COUNT; ++i) {
+        mSlot[i].mPrev = &mSlot[i];
+        mSlot[i].mNext = &mSlot[i];
+    }
+}
+
+
+CTimerWheel::~CTimerWheel() {
+    clear();
+}
+
+
+void CTimerWheel::clear(u32 tick) {
+    for(u32 i = 0; i < ESLOT_COUNT; ++i) {
+        for(SLink* it = mSlot[i].mNext; it != &mSlot[i]; it = it->mNext) {
+            ((STimerNode*) it)->mTask.discard();
+        }
+    }
+    for(u32 i = 0; i < mBlocks.size(); ++i) {
+        delete[] mBlocks[i];
+    }
+    mBlocks.clear();
+    mFree = 0;
+    for(u32 i = 0; i < ESLOT_COUNT; ++i) {
+        mSlot[i].mPrev = &mSlot[i];
+        mSlot[i].mNext = &mSlot[i];
+    }
+    mCount = 0;
+    mRootCount = 0;
+    mTick = tick;
+}
+
+
+CTimerWheel::STimerNode* CTimerWheel::allocNode() {
+    if(!mFree) {
+        STimerNode* block = new STimerNode[EBLOCK_SIZE];
+        const u32 base = mBlocks.size() << EBLOCK_BITS;
+        mBlocks.push_back(block);
+        //lower index at head of free list.
+        for(u32 i = EBLOCK_SIZE; i > 0; --i) {
+            STimerNode& node = block[i - 1];
+            node.mIndex = base + i - 1;
+            node.mSerial = 1;
+            node.mPrev = 0;
+            node.mNext = mFree;
+            mFree = &node;
+        }
+    }
+    STimerNode* ret = mFree;
+    mFree = (STimerNode*) ret->mNext;
+    return ret;
+}
+
+
+void CTimerWheel::freeNode(STimerNode* it) {
+    if(0 == ++it->mSerial) {
+        it->mSerial = 1;
+    }
+    it->mPrev = 0;
+    it->mNext = mFree;
+    mFree = it;
+}
+
+
+void CTimerWheel::link(STimerNode* it) {
+    const u32 expire = it->mExpire;
+    const u32 ticks = expire - mTick;
+    if(ticks < EROOT_SIZE) {
+        it->mSlot = expire & EROOT_MASK;
+    } else if((s32) ticks < 0) {
+        //expired, fire at current tick.
+        it->mSlot = mTick & EROOT_MASK;
+    } else {
+        u32 level = 0;
+        while(level < ELEVEL_COUNT - 1 && ticks >= (1U << (EROOT_BITS + (level + 1) * ELEVEL_BITS))) {
+            ++level;
+        }
+        it->mSlot = EROOT_SIZE + level * ELEVEL_SIZE
+            + ((expire >> (EROOT_BITS + level * ELEVEL_BITS)) & ELEVEL_MASK);
+    }
+    SLink& head = mSlot[it->mSlot];
+    it->mNext = &head;
+    it->mPrev = head.mPrev;
+    head.mPrev->mNext = it;
+    head.mPrev = it;
+    if(it->mSlot < EROOT_SIZE) {
+        ++mRootCount;
+    }
+    ++mCount;
+}
+
+
+void CTimerWheel::unlink(STimerNode* it) {
+    it->mPrev->mNext = it->mNext;
+    it->mNext->mPrev = it->mPrev;
+    if(it->mSlot < EROOT_SIZE) {
+        --mRootCount;
+    }
+    --mCount;
+}
+
+
+u32 CTimerWheel::cascade(u32 level) {
+    const u32 index = (mTick >> (EROOT_BITS + level * ELEVEL_BITS)) & ELEVEL_MASK;
+    SLink& head = mSlot[EROOT_SIZE + level * ELEVEL_SIZE + index];
+    while(head.mNext != &head) {
+        STimerNode* node = (STimerNode*) head.mNext;
+        unlink(node);
+        link(node);
+    }
+    return index;
+}
+
+
+u64 CTimerWheel::add(const SThreadTask& task, u32 expire, u32 period, u32 iPriority) {
+    STimerNode* node = allocNode();
+    node->mTask = task;
+    node->mExpire = expire;
+    node->mPeriod = period;
+    node->mPriority = iPriority;
+    link(node);
+    return ((u64) node->mSerial << 32) | (node->mIndex + 1);
+}
+
+
+bool CTimerWheel::cancel(u64 id) {
+    const u32 index = (u32) id - 1;
+    if(index >= (mBlocks.size() << EBLOCK_BITS)) {
+        return false;
+    }
+    STimerNode* node = getNode(index);
+    if(node->mSerial != (u32) (id >> 32) || !node->mPrev) {
+        return false;
+    }
+    unlink(node);
+    freeNode(node);
+    return true;
+}
+
+
+u32 CTimerWheel::update(u32 now, core::array<STimerTask>& fired) {
+    u32 ret = 0;
+    while(mCount > 0 && (s32) (now - mTick) >= 0) {
+        const u32 index = mTick & EROOT_MASK;
+        if(0 == index) {
+            for(u32 level = 0; level < ELEVEL_COUNT && 0 == cascade(level); ++level) {
+            }
+        }
+        SLink& head = mSlot[index];
+        while(head.mNext != &head) {
+            STimerNode* node = (STimerNode*) head.mNext;
+            unlink(node);
+            STimerTask item;
+            item.mTask = node->mTask;
+            item.mPriority = node->mPriority;
+            item.mPeriod = node->mPeriod;
+            fired.push_back(item);
+            ++ret;
+            if(node->mPeriod > 0) {
+                //keep the schedule, no drift.
+                node->mExpire = mTick + node->mPeriod;
+                link(node);
+            } else {
+                freeNode(node);
+            }
+        }
+        ++mTick;
+    }
+    if(0 == mCount && (s32) (now - mTick) >= 0) {
+        mTick = now + 1;
+    }
+    return ret;
+}
+
+
+u32 CTimerWheel::getIdleTicks()const {
+    if(0 == mCount) {
+        return 0xFFFFFFFFU;
+    }
+    u32 ret = 0xFFFFFFFFU;
+    if(mRootCount > 0) {
+        for(u32 i = 0; i < EROOT_SIZE; ++i) {
+            const SLink& head = mSlot[(mTick + i) & EROOT_MASK];
+            if(head.mNext != &head) {
+                ret = i;
+                break;
+            }
+        }
+    }
+    if(mRootCount < mCount) {
+        //timers of upper wheels may be cascaded to the 1st wheel at next round.
+        const u32 round = (EROOT_SIZE - (mTick & EROOT_MASK)) & EROOT_MASK;
+        ret = round < ret ? round : ret;
+    }
+    return ret;
+}
+
+}//irr
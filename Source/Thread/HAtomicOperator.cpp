@@ -34,6 +34,10 @@ void AppAtomicReadWriteBarrier() {
     ::_ReadWriteBarrier();
 }
 
+void AppCpuRelax() {
+    YieldProcessor();
+}
+
 void* AppAtomicFetchSet(void* value, void** iTarget) {
     return ::InterlockedExchangePointer(iTarget, value);
 }
@@ -86,6 +90,10 @@ s32 AppAtomicFetchCompareSet(s32 newValue, s32 comparand, s32* iTarget) {
     return ::InterlockedCompareExchange((LONG*) iTarget, newValue, comparand);
 }
 
+void* AppAtomicFetchCompareSet(void* newValue, void* comparand, void** iTarget) {
+    return ::InterlockedCompareExchangePointer(iTarget, newValue, comparand);
+}
+
 
 //64bit functions---------------------------------------------
 s64 AppAtomicIncrementFetch(s64* it) {
@@ -113,6 +121,10 @@ s32 AppAtomicFetch(s32* iTarget) {
     return ::InterlockedExchangeAdd((LONG*) iTarget, 0);
 }
 
+void* AppAtomicFetch(void** iTarget) {
+    return ::InterlockedCompareExchangePointer(iTarget, 0, 0);
+}
+
 
 } //end namespace irr
 
@@ -132,6 +144,16 @@ void AppAtomicReadWriteBarrier() {
     //::__sync_synchronize();
 }
 
+void AppCpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" : : : "memory");
+#else
+    __asm__ __volatile__("" : : : "memory");
+#endif
+}
+
 s32 AppAtomicFetchAdd(s32 addValue, s32* iTarget) {
     // in gcc >= 4.7:
     return  ::__atomic_fetch_add(iTarget, addValue, __ATOMIC_SEQ_CST);
@@ -140,7 +162,34 @@ s32 AppAtomicFetchAdd(s32 addValue, s32* iTarget) {
 
 
 void* AppAtomicFetchSet(void* iValue, void** iTarget) {
-    //return ::__sync_lock_release(iTarget, iValue);
+    return ::__atomic_exchange_n(iTarget, iValue, __ATOMIC_SEQ_CST);
+}
+
+
+s32 AppAtomicFetchOr(s32 value, s32* iTarget) {
+    return ::__atomic_fetch_or(iTarget, value, __ATOMIC_SEQ_CST);
+}
+
+s16 AppAtomicFetchOr(s16 value, s16* iTarget) {
+    return ::__atomic_fetch_or(iTarget, value, __ATOMIC_SEQ_CST);
+}
+
+
+s32 AppAtomicFetchXor(s32 value, s32* iTarget) {
+    return ::__atomic_fetch_xor(iTarget, value, __ATOMIC_SEQ_CST);
+}
+
+s16 AppAtomicFetchXor(s16 value, s16* iTarget) {
+    return ::__atomic_fetch_xor(iTarget, value, __ATOMIC_SEQ_CST);
+}
+
+
+s32 AppAtomicFetchAnd(s32 value, s32* iTarget) {
+    return ::__atomic_fetch_and(iTarget, value, __ATOMIC_SEQ_CST);
+}
+
+s16 AppAtomicFetchAnd(s16 value, s16* iTarget) {
+    return ::__atomic_fetch_and(iTarget, value, __ATOMIC_SEQ_CST);
 }
 
 
@@ -164,11 +213,20 @@ s32 AppAtomicFetchCompareSet(s32 newValue, s32 comparand, s32* iTarget) {
     return comparand;
 }
 
+void* AppAtomicFetchCompareSet(void* newValue, void* comparand, void** iTarget) {
+    ::__atomic_compare_exchange_n(iTarget, &comparand, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
 
 s32 AppAtomicFetch(s32* iTarget) {
     return ::__atomic_load_n(iTarget, __ATOMIC_SEQ_CST);
 }
 
+void* AppAtomicFetch(void** iTarget) {
+    return ::__atomic_load_n(iTarget, __ATOMIC_SEQ_CST);
+}
+
 } //end namespace irr
 #endif //APP_PLATFORM_WINDOWS
 